@@ -449,7 +449,7 @@ gen_script_test_targets() {
 bc_only=0
 dc_only=0
 coverage=0
-karatsuba_len=32
+karatsuba_len=64
 debug=0
 hist=1
 extra_math=1
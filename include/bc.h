@@ -147,6 +147,18 @@ void bc_lex_token(BcLex *l);
 // the first in the expr enum. Note: This only works for binary operators.
 #define BC_PARSE_TOKEN_INST(t) ((uchar) ((t) - BC_LEX_NEG + BC_INST_NEG))
 
+// The len of the BcInstPtr of an exit label is 0, or BC_PARSE_EXIT_TRUE if it
+// is the exit of an if whose condition is always true. If the code from where
+// it was created to where it is set can never run, it is where that code
+// starts, plus one, and setting the label drops that code.
+#define BC_PARSE_EXIT_TRUE (SIZE_MAX)
+
+// The most limbs that a power of constants can have and still be folded, so
+// that the parser does not spend time and memory on a power that never runs.
+#ifndef BC_PARSE_FOLD_LEN
+#define BC_PARSE_FOLD_LEN (64)
+#endif // BC_PARSE_FOLD_LEN
+
 typedef enum BcParseStatus {
 
 	BC_PARSE_STATUS_SUCCESS,
@@ -169,6 +169,7 @@ typedef enum BcInst {
 	BC_INST_JUMP_ZERO,
 
 	BC_INST_CALL,
+	BC_INST_TAIL_CALL,
 
 	BC_INST_RET,
 	BC_INST_RET0,
@@ -204,6 +205,21 @@ typedef enum BcInst {
 	BC_INST_NQUIT,
 #endif // DC_ENABLED
 
+#if BC_ENABLED
+	// These are never parsed; bc_program_decode() fuses them from common
+	// sequences of the instructions above.
+	BC_INST_JUMP_REL,
+	BC_INST_VAR_OP,
+	BC_INST_VAR_OP_ASSIGN,
+	BC_INST_OP_ASSIGN,
+	BC_INST_ASSIGN_VAR,
+
+	// These run expressions that bc_program_decode() compiles to register code.
+	BC_INST_EXPR,
+	BC_INST_EXPR_ASSIGN,
+	BC_INST_EXPR_JUMP,
+#endif // BC_ENABLED
+
 	BC_INST_INVALID = UCHAR_MAX,
 
 } BcInst;
@@ -218,16 +234,60 @@ typedef struct BcLoc {
 	size_t idx;
 } BcLoc;
 
+// How many bases a constant keeps its value in, so that scripts that switch
+// ibase back and forth do not parse the same constants over and over.
+#define BC_CONST_BASES (4)
+
+// The base of a constant that has the same value in every base.
+#define BC_CONST_FOLDED (0)
+
 typedef struct BcConst {
 	char *val;
-	BcBigDig base;
-	BcNum num;
+	// The bases the constant was parsed in, most recently used first, and its
+	// value in each of them. Unused slots have a base of BC_NUM_BIGDIG_MAX. A
+	// constant that bc folded from others has a first base of BC_CONST_FOLDED,
+	// an empty val, and its value in the first slot.
+	BcBigDig base[BC_CONST_BASES];
+	BcNum num[BC_CONST_BASES];
 } BcConst;
 
+#if BC_ENABLED
+// One operation of an expression that bc_program_decode() has compiled to work
+// on registers instead of the results stack.
+typedef struct BcRegOp {
+
+	// The binary operator or comparison.
+	uchar inst;
+
+	// Where the operands come from: BC_INST_VAR, BC_INST_NUM, BC_INST_ZERO, or
+	// BC_INST_ONE for one that is read where it is, with a and b being the
+	// index of the variable or constant, or BC_PROG_REG for a register.
+	uchar a_t;
+	uchar b_t;
+	size_t a;
+	size_t b;
+
+	// The register that the result is put in.
+	size_t dst;
+
+} BcRegOp;
+#endif // BC_ENABLED
+
 typedef struct BcFunc {
 
 	BcVec code;
+
+	// The code decoded into whole words, which is what is actually executed.
+	// Every instruction is one word, followed by its operands, one word each,
+	// and jumps go straight to the word of their label. decoded is how many
+	// bytes of code have been decoded so far.
+	BcVec insts;
+	size_t decoded;
+
 #if BC_ENABLED
+	// The register code of the expressions in insts.
+	BcVec ir;
+
 	BcVec labels;
 	BcVec autos;
 	size_t nparams;
@@ -302,6 +362,7 @@ void bc_func_init(BcFunc *f, const char* name);
 void bc_func_insert(BcFunc *f, struct BcProgram* p, char* name,
                     BcType type, size_t line);
 void bc_func_reset(BcFunc *f);
+void bc_func_clearCode(BcFunc *f);
 void bc_func_free(void *func);
 
 void bc_array_init(BcVec *a, bool nums);
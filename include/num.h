@@ -87,12 +87,72 @@ typedef int_least16_t BcDig;
 
 #define BC_NUM_DEF_SIZE (8)
 
+// The quotient and remainder of BC_NUM_BIGDIG_MAX + 1 divided by BC_BASE_POW.
+// The brute force multiplication kernels sum columns in two BcBigDig's, and
+// these split such a sum into digits without a wider type.
+#define BC_NUM_COL_DIV (BC_NUM_BIGDIG_MAX / BC_BASE_POW)
+#define BC_NUM_COL_MOD (BC_NUM_BIGDIG_MAX % BC_BASE_POW + 1)
+
+// Whether the brute force multiplication kernels work on pairs of digits, as
+// single digits of BC_BASE_POW^2, with 128-bit products. That only works with
+// 64-bit BcBigDig's and compilers that have 128-bit integers.
+#ifndef BC_NUM_WIDE
+#if BC_LONG_BIT >= 64 && defined(__SIZEOF_INT128__)
+#define BC_NUM_WIDE (1)
+#else // BC_LONG_BIT >= 64 && defined(__SIZEOF_INT128__)
+#define BC_NUM_WIDE (0)
+#endif // BC_LONG_BIT >= 64 && defined(__SIZEOF_INT128__)
+#elif BC_NUM_WIDE && (BC_LONG_BIT < 64 || !defined(__SIZEOF_INT128__))
+#error BC_NUM_WIDE needs BC_LONG_BIT of at least 64 and 128-bit integers.
+#endif // BC_NUM_WIDE
+
+#if BC_NUM_WIDE
+
+__extension__ typedef unsigned __int128 BcWideDig;
+
+// The base of the digits in the wide kernels.
+#define BC_NUM_WIDE_POW (((BcBigDig) BC_BASE_POW) * BC_BASE_POW)
+
+#endif // BC_NUM_WIDE
+
+// Whether the limb kernels have SIMD versions, which bc_num_simdInit() picks
+// from when bc starts: SSE2 or AVX2 on x86-64, depending on the CPU, and NEON
+// on AArch64. They use GCC and Clang extensions and work on 32-bit digits. The
+// portable kernels are the fallback. It can be turned off by defining it to 0
+// in CFLAGS when running configure.sh.
+#ifndef BC_NUM_SIMD
+#if BC_LONG_BIT >= 64 && (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__aarch64__))
+#define BC_NUM_SIMD (1)
+#else // BC_LONG_BIT >= 64 && ...
+#define BC_NUM_SIMD (0)
+#endif // BC_LONG_BIT >= 64 && ...
+#elif BC_NUM_SIMD && \
+      (BC_LONG_BIT < 64 || (!defined(__x86_64__) && !defined(__aarch64__)))
+#error BC_NUM_SIMD needs BC_LONG_BIT of at least 64 on x86-64 or AArch64.
+#endif // BC_NUM_SIMD
+
+// The binary words that bc_num_modexp() uses for odd moduli, and a type that
+// can hold a product of two of them plus two more.
+#if BC_NUM_WIDE
+typedef uint64_t BcNumWord;
+typedef BcWideDig BcNumDWord;
+#define BC_NUM_WORD_BITS (64)
+#else // BC_NUM_WIDE
+typedef uint32_t BcNumWord;
+typedef uint64_t BcNumDWord;
+#define BC_NUM_WORD_BITS (32)
+#endif // BC_NUM_WIDE
+
 typedef struct BcNum {
 	BcDig *restrict num;
 	size_t rdx;
 	size_t scale;
 	size_t len;
 	size_t cap;
+	// Whether num came from bc_num_init(), and so has a reference count in
+	// front of it and can be shared with bc_num_share().
+	bool ref;
 } BcNum;
 
 #if BC_ENABLE_EXTRA_MATH
@@ -116,11 +176,62 @@ struct BcRNG;
 #define BC_NUM_PRINT_WIDTH (BC_NUM_BIGDIG_C(69))
 
 #ifndef BC_NUM_KARATSUBA_LEN
-#define BC_NUM_KARATSUBA_LEN (BC_NUM_BIGDIG_C(32))
+#define BC_NUM_KARATSUBA_LEN (BC_NUM_BIGDIG_C(64))
 #elif BC_NUM_KARATSUBA_LEN < 16
 #error BC_NUM_KARATSUBA_LEN must be at least 16.
+#elif BC_NUM_WIDE && BC_NUM_KARATSUBA_LEN > 640
+// The wide kernels sum whole columns of up to BC_NUM_KARATSUBA_LEN / 2
+// products of BC_NUM_WIDE_POW digits, and more than 339 of them can overflow.
+#error BC_NUM_KARATSUBA_LEN must be at most 640 with BC_NUM_WIDE.
 #endif // BC_NUM_KARATSUBA_LEN
 
+#ifndef BC_NUM_TOOM3_LEN
+#if BC_NUM_KARATSUBA_LEN > 128
+#define BC_NUM_TOOM3_LEN (BC_NUM_KARATSUBA_LEN)
+#else // BC_NUM_KARATSUBA_LEN > 128
+#define BC_NUM_TOOM3_LEN (BC_NUM_BIGDIG_C(128))
+#endif // BC_NUM_KARATSUBA_LEN > 128
+#elif BC_NUM_TOOM3_LEN < BC_NUM_KARATSUBA_LEN
+#error BC_NUM_TOOM3_LEN must be at least BC_NUM_KARATSUBA_LEN.
+#endif // BC_NUM_TOOM3_LEN
+
+#ifndef BC_NUM_NTT_LEN
+#define BC_NUM_NTT_LEN (BC_NUM_BIGDIG_C(1024))
+#elif BC_NUM_NTT_LEN < BC_NUM_TOOM3_LEN
+#error BC_NUM_NTT_LEN must be at least BC_NUM_TOOM3_LEN.
+#endif // BC_NUM_NTT_LEN
+
+#ifndef BC_NUM_NEWTON_LEN
+#define BC_NUM_NEWTON_LEN (BC_NUM_BIGDIG_C(512))
+#elif BC_NUM_NEWTON_LEN < 4
+#error BC_NUM_NEWTON_LEN must be at least 4.
+#endif // BC_NUM_NEWTON_LEN
+
+#ifndef BC_NUM_SQRT_LEN
+#define BC_NUM_SQRT_LEN (BC_NUM_BIGDIG_C(64))
+#elif BC_NUM_SQRT_LEN < 4
+#error BC_NUM_SQRT_LEN must be at least 4.
+#endif // BC_NUM_SQRT_LEN
+
+#ifndef BC_NUM_CONV_LEN
+#define BC_NUM_CONV_LEN (BC_NUM_BIGDIG_C(64))
+#elif BC_NUM_CONV_LEN < 2
+#error BC_NUM_CONV_LEN must be at least 2.
+#endif // BC_NUM_CONV_LEN
+
+// Digit arrays up to BC_NUM_DEF_SIZE << (BC_NUM_POOL_CLASSES - 1) digits long
+// are rounded up to a power of two times BC_NUM_DEF_SIZE and recycled through
+// one free list per size. No more than BC_NUM_POOL_MAX bytes are kept around.
+#ifndef BC_NUM_POOL_CLASSES
+#define BC_NUM_POOL_CLASSES (12)
+#elif BC_NUM_POOL_CLASSES < 1 || BC_NUM_POOL_CLASSES > 24
+#error BC_NUM_POOL_CLASSES must be between 1 and 24.
+#endif // BC_NUM_POOL_CLASSES
+
+#ifndef BC_NUM_POOL_MAX
+#define BC_NUM_POOL_MAX (((size_t) 1) << 22)
+#endif // BC_NUM_POOL_MAX
+
 // A crude, but always big enough, calculation of
 // the size required for ibase and obase BcNum's.
 #define BC_NUM_BIGDIG_LOG10 (BC_NUM_DEF_SIZE)
@@ -131,7 +242,31 @@ struct BcRNG;
 
 #define BC_NUM_NUM_LETTER(c) ((c) - 'A' + BC_BASE)
 
-#define BC_NUM_KARATSUBA_ALLOCS (6)
+// The capacity that a product needs in bc_num_k() when neither operand has
+// more than n digits. Karatsuba needs one extra digit for carries before it
+// subtracts the middle term, and the brute force kernels need one past the end.
+#define BC_NUM_KREQ(n) (2 * (n) + 2)
+
+// How many bits of the exponent are pulled out at a time in bc_num_modexp().
+// 2^(3 * BC_BASE_DIGS) is always less than BC_BASE_POW.
+#define BC_NUM_EXP_BITS (3 * BC_BASE_DIGS)
+
+// The largest window for the sliding window in bc_num_modexp().
+#define BC_NUM_EXP_WINDOW (6)
+
+// The three primes for the number-theoretic transform. They are all of the form
+// k * 2^m + 1 (with m >= BC_NUM_NTT_MAX_LOG), below 2^30, and have 3 as a
+// primitive root. Their product is big enough to hold any convolution of
+// BcDig's with up to 2^BC_NUM_NTT_MAX_LOG terms. The inverses are the ones
+// needed to put the three residues back together with the CRT.
+#define BC_NUM_NTT_P1 (UINT32_C(998244353))
+#define BC_NUM_NTT_P2 (UINT32_C(167772161))
+#define BC_NUM_NTT_P3 (UINT32_C(469762049))
+#define BC_NUM_NTT_ROOT (UINT32_C(3))
+#define BC_NUM_NTT_MAX_LOG (23)
+#define BC_NUM_NTT_P1_INV_P2 (UINT64_C(47450712))
+#define BC_NUM_NTT_P1_INV_P3 (UINT64_C(208783132))
+#define BC_NUM_NTT_P2_INV_P3 (UINT64_C(104391568))
 
 #define BC_NUM_ROUND_POW(s) (bc_vm_growSize((s), BC_BASE_DIGS - 1))
 #define BC_NUM_RDX(s) (BC_NUM_ROUND_POW(s) / BC_BASE_DIGS)
@@ -176,11 +311,16 @@ typedef void (*BcNumBinOp)(BcNum*, BcNum*, BcNum* restrict, size_t);
 typedef size_t (*BcNumBinaryOpReq)(const BcNum*, const BcNum*, size_t);
 typedef void (*BcNumDigitOp)(size_t, size_t, bool);
 typedef void (*BcNumShiftAddOp)(BcDig* restrict, const BcDig* restrict, size_t);
+typedef BcBigDig (*BcNumMulDigitsOp)(BcDig* restrict, const BcDig* restrict,
+                                     size_t, BcBigDig);
+typedef ssize_t (*BcNumCmpOp)(const BcDig* restrict, const BcDig* restrict,
+                              size_t);
 
 void bc_num_init(BcNum *restrict n, size_t req);
 void bc_num_setup(BcNum *restrict n, BcDig *restrict num, size_t cap);
 void bc_num_copy(BcNum *d, const BcNum *s);
 void bc_num_createCopy(BcNum *d, const BcNum *s);
+void bc_num_share(BcNum *d, const BcNum *s);
 void bc_num_createFromBigdig(BcNum *n, BcBigDig val);
 void bc_num_clear(BcNum *restrict n);
 void bc_num_free(void *num);
@@ -202,6 +342,7 @@ void bc_num_createFromRNG(BcNum *restrict n, struct BcRNG *rng);
 void bc_num_add(BcNum *a, BcNum *b, BcNum *c, size_t scale);
 void bc_num_sub(BcNum *a, BcNum *b, BcNum *c, size_t scale);
 void bc_num_mul(BcNum *a, BcNum *b, BcNum *c, size_t scale);
+void bc_num_sqr(BcNum *a, BcNum *c, size_t scale);
 void bc_num_div(BcNum *a, BcNum *b, BcNum *c, size_t scale);
 void bc_num_mod(BcNum *a, BcNum *b, BcNum *c, size_t scale);
 void bc_num_pow(BcNum *a, BcNum *b, BcNum *c, size_t scale);
@@ -246,6 +387,10 @@ void bc_num_print(BcNum *restrict n, BcBigDig base, bool newline);
 void bc_num_stream(BcNum *restrict n, BcBigDig base);
 #endif // DC_ENABLED
 
+#if BC_NUM_SIMD
+void bc_num_simdInit(void);
+#endif // BC_NUM_SIMD
+
 #if BC_DEBUG_CODE
 void bc_num_printDebug(const BcNum *n, const char *name, bool emptyline);
 void bc_num_printDigs(const BcDig* n, size_t len, bool emptyline);
@@ -91,6 +91,23 @@ typedef struct BcParse {
 	BcVec conds;
 	BcVec ops;
 	BcVec buf;
+
+	// The constants that the code of the current expression ends with, as a
+	// BcLoc of where each starts and its index in consts, and where the last
+	// one ends. Operators on them are folded into one constant.
+	BcVec folds;
+	size_t fold_end;
+
+	// Where the unreachable code after a return, break, or continue starts,
+	// plus one, or 0 if there is none, and how many flags the block that it is
+	// in has.
+	size_t dead;
+	size_t dead_len;
+
+	// Where the last call starts and ends in the code, so that a return of its
+	// value can make it a tail call.
+	size_t call;
+	size_t call_end;
 #endif // BC_ENABLED
 
 	struct BcProgram *prog;
@@ -99,6 +116,13 @@ typedef struct BcParse {
 
 	bool auto_part;
 
+#if BC_ENABLED
+	// Whether ibase or read() has been parsed, after which bc does not know
+	// what base constants are in, and whether a loop header is being parsed.
+	bool ibase;
+	bool loop;
+#endif // BC_ENABLED
+
 } BcParse;
 
 void bc_parse_init(BcParse *p, struct BcProgram *prog, size_t func);
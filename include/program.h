@@ -94,6 +94,11 @@ typedef struct BcProgram {
 
 #if BC_ENABLED
 	BcNum last;
+
+	// The registers of compiled expressions. An expression never calls a
+	// function, so all of them can share one set of registers, and the numbers
+	// keep their digits from one run to the next.
+	BcVec regs;
 #endif // BC_ENABLED
 
 #if DC_ENABLED
@@ -122,6 +127,84 @@ typedef struct BcProgram {
 #define bc_program_retire(p, nres, nops) \
 	(bc_vec_npopAt(&(p)->results, (nops), (p)->results.len - (nres + nops)))
 
+#if BC_ENABLED
+
+#if BC_ENABLE_EXTRA_MATH
+#define BC_PROG_LAST_OP (BC_INST_RSHIFT)
+#else // BC_ENABLE_EXTRA_MATH
+#define BC_PROG_LAST_OP (BC_INST_MINUS)
+#endif // BC_ENABLE_EXTRA_MATH
+
+// These classify instructions for the superinstructions in bc_program_decode().
+// An operand source is an instruction that pushes a number that can be read
+// without pushing it.
+#define BC_PROG_OP(i) ((i) >= BC_INST_POWER && (i) <= BC_PROG_LAST_OP)
+#define BC_PROG_LOGICAL(i) ((i) >= BC_INST_REL_EQ && (i) <= BC_INST_BOOL_AND)
+#define BC_PROG_ASSIGN_NO_VAL(i) \
+	((i) >= BC_INST_ASSIGN_POWER_NO_VAL && (i) <= BC_INST_ASSIGN_NO_VAL)
+#define BC_PROG_SRC(i) \
+	((i) == BC_INST_NUM || (i) == BC_INST_VAR || \
+	 (i) == BC_INST_ZERO || (i) == BC_INST_ONE)
+
+// Whether bc_program_decode() compiles expressions that only use variables and
+// constants into register code. It can be turned off by defining it to 0 in
+// CFLAGS when running configure.sh.
+#ifndef BC_PROG_REGS
+#define BC_PROG_REGS (1)
+#endif // BC_PROG_REGS
+
+// The deepest that an expression can get on the results stack and still be
+// compiled. This also bounds the number of registers.
+#define BC_PROG_REGS_DEPTH (16)
+
+// The operand type of a register in a BcRegOp.
+#define BC_PROG_REG (BC_INST_INVALID)
+
+#endif // BC_ENABLED
+
+// Whether bc_program_exec() dispatches with computed gotos, which GCC and Clang
+// have as an extension, instead of a switch. Every handler then jumps straight
+// to the next one, which branch predictors do much better with than the one
+// indirect jump of a switch. It can be turned off by defining it to 0 in
+// CFLAGS when running configure.sh.
+#ifndef BC_PROG_THREADED
+#if defined(__GNUC__) || defined(__clang__)
+#define BC_PROG_THREADED (1)
+#else // defined(__GNUC__) || defined(__clang__)
+#define BC_PROG_THREADED (0)
+#endif // defined(__GNUC__) || defined(__clang__)
+#endif // BC_PROG_THREADED
+
+// These are only for bc_program_exec(). BC_PROG_CASE() starts the handler of
+// an instruction, and BC_PROG_NEXT ends it.
+#if BC_PROG_THREADED
+
+#define BC_PROG_LBL(i) (__extension__ &&bc_program_lbl_##i)
+#define BC_PROG_JUMP(i)                            \
+	__extension__ ({                               \
+		assert(bc_program_lbls[(i)] != NULL);      \
+		goto *bc_program_lbls[(i)];                \
+	})
+
+#define BC_PROG_SWITCH(i) BC_PROG_JUMP(i);
+#define BC_PROG_CASE(i) bc_program_lbl_##i:
+#define BC_PROG_NEXT                               \
+	do {                                           \
+		assert(jmp_bufs_len == vm.jmp_bufs.len);   \
+		if (ip->idx >= func->insts.len) return;    \
+		BC_SIG_ASSERT_NOT_LOCKED;                  \
+		inst = (uchar) code[(ip->idx)++];          \
+		BC_PROG_JUMP(inst);                        \
+	} while (0)
+
+#else // BC_PROG_THREADED
+
+#define BC_PROG_SWITCH(i) switch (i)
+#define BC_PROG_CASE(i) case i:
+#define BC_PROG_NEXT break
+
+#endif // BC_PROG_THREADED
+
 #if DC_ENABLED
 #define BC_PROG_REQ_FUNCS (2)
 #if !BC_ENABLED
@@ -168,6 +251,9 @@ size_t bc_program_insertFunc(BcProgram *p, const char *name);
 void bc_program_reset(BcProgram *p);
 void bc_program_exec(BcProgram *p);
 
+BcNum* bc_program_constVal(BcConst *c, BcBigDig base);
+bool bc_program_compare(uchar inst, BcNum *n1, BcNum *n2);
+
 void bc_program_negate(BcResult *r, BcNum *n);
 void bc_program_not(BcResult *r, BcNum *n);
 #if BC_ENABLE_EXTRA_MATH
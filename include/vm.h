@@ -330,7 +330,13 @@ typedef struct BcVm {
 
 	BcVec jmp_bufs;
 
-	BcVec temps;
+	// The free lists of digit array allocations, one per size class, linked
+	// through the first bytes of each allocation, the bytes they hold, and how
+	// many requests they did and did not satisfy.
+	void *pool[BC_NUM_POOL_CLASSES];
+	size_t pool_size;
+	size_t pool_hits;
+	size_t pool_misses;
 
 #if BC_ENABLE_LIBRARY
 
@@ -398,6 +404,10 @@ typedef struct BcVm {
 	BcBigDig last_exp;
 	BcBigDig last_rem;
 
+	// The powers last_pow^(2^i), which are what huge numbers are split by when
+	// they are printed in last_base.
+	BcVec last_pows;
+
 #if !BC_ENABLE_LIBRARY
 	char *env_args_buffer;
 	BcVec env_args;
@@ -95,6 +95,23 @@ static bool bc_parse_isDelimiter(const BcParse *p) {
 	return good;
 }
 
+// Drops the code from len on, along with the labels that were set in it.
+static void bc_parse_truncate(BcParse *p, size_t len) {
+
+	BcFunc *f = p->func;
+	size_t i;
+
+	if (len >= f->code.len) return;
+
+	bc_vec_npop(&f->code, f->code.len - len);
+	bc_vec_popAll(&p->folds);
+
+	for (i = 0; i < f->labels.len; ++i) {
+		size_t *label = bc_vec_item(&f->labels, i);
+		if (*label != SIZE_MAX && *label > len) *label = SIZE_MAX;
+	}
+}
+
 static void bc_parse_setLabel(BcParse *p) {
 
 	BcFunc *func = p->func;
@@ -103,6 +120,10 @@ static void bc_parse_setLabel(BcParse *p) {
 
 	assert(func == bc_vec_item(&p->prog->fns, p->fidx));
 
+	// The code that can never run is dropped before the label is set.
+	if (ip->len && ip->len != BC_PARSE_EXIT_TRUE)
+		bc_parse_truncate(p, ip->len - 1);
+
 	label = bc_vec_item(&func->labels, ip->idx);
 	*label = func->code.len;
 
@@ -132,6 +153,209 @@ static void bc_parse_createExitLabel(BcParse *p, size_t idx, bool loop) {
 	bc_parse_createLabel(p, SIZE_MAX);
 }
 
+// Notes that the code from here to the end of the block can never run, after a
+// return, break, or continue.
+static void bc_parse_setDead(BcParse *p) {
+	if (p->dead) return;
+	p->dead = p->func->code.len + 1;
+	p->dead_len = p->flags.len;
+}
+
+// Notes that the code from start on is a constant, which is at idx in consts if
+// it is not a zero or a one.
+static void bc_parse_addFold(BcParse *p, size_t start, size_t idx) {
+
+	BcLoc loc;
+
+	// Only constants that follow each other right up to the end of the code
+	// can be folded.
+	if (p->fold_end != start) bc_vec_popAll(&p->folds);
+
+	loc.loc = start;
+	loc.idx = idx;
+
+	bc_vec_push(&p->folds, &loc);
+	p->fold_end = p->func->code.len;
+}
+
+// Parses a number and notes it for folding, unless it is in exponent notation,
+// which is pushed as a shift.
+static void bc_parse_const(BcParse *p) {
+
+	size_t start = p->func->code.len, idx = p->func->consts.len;
+	bool exp = (strchr(p->l.str.v, 'e') != NULL);
+
+	bc_parse_number(p);
+
+	if (!exp) bc_parse_addFold(p, start, idx);
+}
+
+// Returns the value of a constant noted for folding, or NULL if it is not known
+// because it depends on ibase.
+static BcNum* bc_parse_foldNum(BcParse *p, const BcLoc *loc) {
+
+	uchar inst = *((uchar*) bc_vec_item(&p->func->code, loc->loc));
+	BcConst *c;
+
+	if (inst == BC_INST_ZERO) return &p->prog->zero;
+	if (inst == BC_INST_ONE) return &p->prog->one;
+
+	assert(inst == BC_INST_NUM);
+
+	c = bc_vec_item(&p->func->consts, loc->idx);
+
+	if (c->base[0] == BC_CONST_FOLDED) return &c->num[0];
+
+	// One digit is the same in every base. Otherwise, the constant is only
+	// known to be in base 10 if ibase has never been touched and the code runs
+	// once, right after it is parsed.
+	if (c->val[1] && (p->ibase || p->loop || p->fidx != BC_PROG_MAIN ||
+	                  BC_PARSE_NO_EXEC(p)))
+	{
+		return NULL;
+	}
+
+	return bc_program_constVal(c, BC_BASE);
+}
+
+// Returns the value of the code from start on if it is one constant, or NULL.
+static BcNum* bc_parse_constVal(BcParse *p, size_t start) {
+
+	BcLoc *loc;
+
+	if (!p->folds.len || p->fold_end != p->func->code.len) return NULL;
+
+	loc = bc_vec_top(&p->folds);
+
+	return loc->loc == start ? bc_parse_foldNum(p, loc) : NULL;
+}
+
+// Folds an operator on the constants that the code ends with into a constant.
+// Division, modulus, and the extra math operators are never folded because
+// their results depend on scale, and neither are multiplications and powers
+// when theirs do. Returns whether it folded.
+static bool bc_parse_fold(BcParse *p, uchar inst) {
+
+	BcFunc *f = p->func;
+	BcNum *a, *b = NULL, res;
+	BcLoc *loc;
+	BcConst c;
+	BcBigDig pow;
+	size_t start, idx, i, n = 1 + !BC_PARSE_PREV_PREFIX(inst);
+
+	if (p->folds.len < n || p->fold_end != f->code.len) return false;
+
+	loc = bc_vec_item_rev(&p->folds, n - 1);
+	start = loc->loc;
+
+	a = bc_parse_foldNum(p, loc);
+	if (a == NULL) return false;
+
+	if (n == 2) {
+		b = bc_parse_foldNum(p, bc_vec_top(&p->folds));
+		if (b == NULL) return false;
+	}
+
+	switch (inst) {
+
+		case BC_INST_NEG:
+		case BC_INST_PLUS:
+		case BC_INST_MINUS:
+		{
+			break;
+		}
+
+		case BC_INST_MULTIPLY:
+		{
+			if (a->scale && b->scale) return false;
+			break;
+		}
+
+		case BC_INST_POWER:
+		{
+			if (b->scale || BC_NUM_NEG(b) || b->len > 1) return false;
+
+			pow = b->len ? (BcBigDig) b->num[0] : 0;
+
+			// A power of zero and any power above 1 of a number with a
+			// fractional part take their scale from scale.
+			if (pow && (BC_NUM_ZERO(a) || (pow > 1 && (a->scale ||
+			            pow > BC_PARSE_FOLD_LEN / a->len))))
+			{
+				return false;
+			}
+
+			break;
+		}
+
+		default:
+		{
+			bool cond;
+
+			if (inst == BC_INST_BOOL_NOT) cond = !bc_num_cmpZero(a);
+			else if (BC_PROG_LOGICAL(inst))
+				cond = bc_program_compare(inst, a, b);
+			else return false;
+
+			bc_vec_npop(&f->code, f->code.len - start);
+			bc_vec_npop(&p->folds, n);
+
+			bc_parse_push(p, cond ? BC_INST_ONE : BC_INST_ZERO);
+			bc_parse_addFold(p, start, SIZE_MAX);
+
+			return true;
+		}
+	}
+
+	BC_SIG_LOCK;
+
+	if (inst == BC_INST_NEG) bc_num_init(&res, a->len);
+	else bc_num_init(&res, bc_program_opReqs[inst - BC_INST_POWER](a, b, 0));
+
+	BC_SETJMP_LOCKED(err);
+
+	BC_SIG_UNLOCK;
+
+	if (inst == BC_INST_NEG) {
+		bc_num_copy(&res, a);
+		if (BC_NUM_NONZERO(&res)) BC_NUM_NEG_TGL_NP(res);
+	}
+	else bc_program_ops[inst - BC_INST_POWER](a, b, &res, 0);
+
+	BC_SIG_LOCK;
+
+	c.val = bc_vm_strdup("");
+	c.base[0] = BC_CONST_FOLDED;
+	memcpy(&c.num[0], &res, sizeof(BcNum));
+
+	for (i = 1; i < BC_CONST_BASES; ++i) {
+		c.base[i] = BC_NUM_BIGDIG_MAX;
+		bc_num_clear(&c.num[i]);
+	}
+
+	idx = f->consts.len;
+	bc_vec_push(&f->consts, &c);
+	bc_num_clear(&res);
+
+	bc_vec_npop(&f->code, f->code.len - start);
+	bc_vec_npop(&p->folds, n);
+
+	bc_parse_push(p, BC_INST_NUM);
+	bc_parse_pushIndex(p, idx);
+	bc_parse_addFold(p, start, idx);
+
+err:
+	BC_SIG_MAYLOCK;
+	bc_num_free(&res);
+	BC_LONGJMP_CONT;
+
+	return true;
+}
+
+static void bc_parse_op(BcParse *p, uchar inst) {
+	if (!bc_parse_fold(p, inst)) bc_parse_push(p, inst);
+}
+
 static void bc_parse_operator(BcParse *p, BcLexType type,
                               size_t start, size_t *nexprs)
 {
@@ -147,7 +371,7 @@ static void bc_parse_operator(BcParse *p, BcLexType type,
 		l = BC_PARSE_OP_PREC(t);
 		if (l >= r && (l != r || !left)) break;
 
-		bc_parse_push(p, BC_PARSE_TOKEN_INST(t));
+		bc_parse_op(p, BC_PARSE_TOKEN_INST(t));
 		bc_vec_pop(&p->ops);
 		*nexprs -= !BC_PARSE_OP_PREFIX(t);
 	}
@@ -160,7 +384,7 @@ static void bc_parse_rightParen(BcParse *p, size_t *nexs) {
 	BcLexType top;
 
 	while ((top = BC_PARSE_TOP_OP(p)) != BC_LEX_LPAREN) {
-		bc_parse_push(p, BC_PARSE_TOKEN_INST(top));
+		bc_parse_op(p, BC_PARSE_TOKEN_INST(top));
 		bc_vec_pop(&p->ops);
 		*nexs -= !BC_PARSE_OP_PREFIX(top);
 	}
@@ -189,6 +413,9 @@ static void bc_parse_params(BcParse *p, uint8_t flags) {
 	}
 
 	if (BC_ERR(comma)) bc_parse_err(p, BC_ERR_PARSE_TOKEN);
+
+	p->call = p->func->code.len;
+
 	bc_parse_push(p, BC_INST_CALL);
 	bc_parse_pushIndex(p, nparams);
 }
@@ -223,6 +450,7 @@ static void bc_parse_call(BcParse *p, const char *name, uint8_t flags) {
 	else idx = ((BcId*) bc_vec_item(&p->prog->fn_map, idx))->idx;
 
 	bc_parse_pushIndex(p, idx);
+	p->call_end = p->func->code.len;
 
 	bc_lex_next(&p->l);
 }
@@ -403,6 +631,7 @@ static void bc_parse_incdec(BcParse *p, BcInst *prev, bool *can_assign,
 		}
 		else if (type >= BC_LEX_KW_LAST && type <= BC_LEX_KW_OBASE) {
 			bc_parse_push(p, type - BC_LEX_KW_LAST + BC_INST_LAST);
+			if (type == BC_LEX_KW_IBASE) p->ibase = true;
 			bc_lex_next(&p->l);
 		}
 		else if (BC_NO_ERR(type == BC_LEX_KW_SCALE)) {
@@ -497,6 +726,8 @@ static void bc_parse_return(BcParse *p) {
 
 		BcParseStatus s;
 
+		p->call_end = SIZE_MAX;
+
 		s = bc_parse_expr_err(p, BC_PARSE_NEEDVAL, bc_parse_next_expr);
 
 		if (s == BC_PARSE_STATUS_EMPTY_EXPR) {
@@ -510,8 +741,19 @@ static void bc_parse_return(BcParse *p) {
 		else if (BC_ERR(p->func->voidfn))
 			bc_parse_verr(p, BC_ERR_PARSE_RET_VOID, p->func->name);
 
+		// If the value is that of a call, the call can take the place of this
+		// function instead of returning to it. The return is still needed in
+		// case it cannot.
+		if (p->call_end == p->func->code.len) {
+			uchar *call = bc_vec_item(&p->func->code, p->call);
+			assert(*call == BC_INST_CALL);
+			*call = BC_INST_TAIL_CALL;
+		}
+
 		bc_parse_push(p, BC_INST_RET);
 	}
+
+	bc_parse_setDead(p);
 }
 
 static void bc_parse_noElse(BcParse *p) {
@@ -543,6 +785,11 @@ static void bc_parse_endBody(BcParse *p, bool brace) {
 
 		if (has_brace && !brace) bc_parse_err(p, BC_ERR_PARSE_TOKEN);
 
+		if (p->dead && len <= p->dead_len) {
+			if (len == p->dead_len) bc_parse_truncate(p, p->dead - 1);
+			p->dead = 0;
+		}
+
 		loop = (BC_PARSE_LOOP_INNER(p) != 0);
 
 		if (loop || BC_PARSE_ELSE(p)) {
@@ -616,41 +863,58 @@ static void bc_parse_startBody(BcParse *p, uint16_t flags) {
 
 static void bc_parse_if(BcParse *p) {
 
-	size_t idx;
+	size_t idx, start, len = 0;
 	uint8_t flags = (BC_PARSE_REL | BC_PARSE_NEEDVAL);
+	BcNum *cond;
 
 	bc_lex_next(&p->l);
 	if (BC_ERR(p->l.t != BC_LEX_LPAREN))
 		bc_parse_err(p, BC_ERR_PARSE_TOKEN);
 
 	bc_lex_next(&p->l);
+	start = p->func->code.len;
 	bc_parse_expr_status(p, flags, bc_parse_next_rel);
 	if (BC_ERR(p->l.t != BC_LEX_RPAREN))
 		bc_parse_err(p, BC_ERR_PARSE_TOKEN);
 
 	bc_lex_next(&p->l);
-	bc_parse_push(p, BC_INST_JUMP_ZERO);
 
 	idx = p->func->labels.len;
+	cond = bc_parse_constVal(p, start);
+
+	// With a constant condition, the body either always runs or never does.
+	if (cond != NULL) {
+		len = bc_num_cmpZero(cond) ? BC_PARSE_EXIT_TRUE : start + 1;
+		bc_parse_truncate(p, start);
+	}
+	else {
+		bc_parse_push(p, BC_INST_JUMP_ZERO);
+		bc_parse_pushIndex(p, idx);
+	}
 
-	bc_parse_pushIndex(p, idx);
 	bc_parse_createExitLabel(p, idx, false);
+	((BcInstPtr*) bc_vec_top(&p->exits))->len = len;
 	bc_parse_startBody(p, BC_PARSE_FLAG_IF);
 }
 
 static void bc_parse_else(BcParse *p) {
 
-	size_t idx = p->func->labels.len;
+	size_t idx = p->func->labels.len, start = p->func->code.len;
+	bool dead;
 
 	if (BC_ERR(!BC_PARSE_IF_END(p)))
 		bc_parse_err(p, BC_ERR_PARSE_TOKEN);
 
+	// If the body of the if always runs, the else never does.
+	dead = (((BcInstPtr*) bc_vec_top(&p->exits))->len == BC_PARSE_EXIT_TRUE);
+
 	bc_parse_push(p, BC_INST_JUMP);
 	bc_parse_pushIndex(p, idx);
 
 	bc_parse_noElse(p);
 
 	bc_parse_createExitLabel(p, idx, false);
+	if (dead) ((BcInstPtr*) bc_vec_top(&p->exits))->len = start + 1;
 	bc_parse_startBody(p, BC_PARSE_FLAG_ELSE);
 
 	bc_lex_next(&p->l);
@@ -658,8 +922,9 @@ static void bc_parse_else(BcParse *p) {
 
 static void bc_parse_while(BcParse *p) {
 
-	size_t idx;
+	size_t idx, start;
 	uint8_t flags = (BC_PARSE_REL | BC_PARSE_NEEDVAL);
+	BcNum *cond;
 
 	bc_lex_next(&p->l);
 	if (BC_ERR(p->l.t != BC_LEX_LPAREN))
@@ -670,19 +935,37 @@ static void bc_parse_while(BcParse *p) {
 	idx = p->func->labels.len;
 	bc_parse_createExitLabel(p, idx, true);
 
+	start = p->func->code.len;
+
+	p->loop = true;
 	bc_parse_expr_status(p, flags, bc_parse_next_rel);
+	p->loop = false;
+
 	if (BC_ERR(p->l.t != BC_LEX_RPAREN))
 		bc_parse_err(p, BC_ERR_PARSE_TOKEN);
 	bc_lex_next(&p->l);
 
-	bc_parse_push(p, BC_INST_JUMP_ZERO);
-	bc_parse_pushIndex(p, idx);
+	cond = bc_parse_constVal(p, start);
+
+	// A loop whose condition is always false never runs, and one whose
+	// condition is always true does not need to check it.
+	if (cond != NULL) {
+		if (!bc_num_cmpZero(cond))
+			((BcInstPtr*) bc_vec_top(&p->exits))->len = start + 1;
+		bc_parse_truncate(p, start);
+	}
+	else {
+		bc_parse_push(p, BC_INST_JUMP_ZERO);
+		bc_parse_pushIndex(p, idx);
+	}
+
 	bc_parse_startBody(p, BC_PARSE_FLAG_LOOP | BC_PARSE_FLAG_LOOP_INNER);
 }
 
 static void bc_parse_for(BcParse *p) {
 
-	size_t cond_idx, exit_idx, body_idx, update_idx;
+	size_t cond_idx, exit_idx, body_idx, update_idx, start, len = 0;
+	BcNum *cond;
 
 	bc_lex_next(&p->l);
 	if (BC_ERR(p->l.t != BC_LEX_LPAREN))
@@ -702,7 +985,10 @@ static void bc_parse_for(BcParse *p) {
 	body_idx = update_idx + 1;
 	exit_idx = body_idx + 1;
 
-	bc_parse_createLabel(p, p->func->code.len);
+	start = p->func->code.len;
+	bc_parse_createLabel(p, start);
+
+	p->loop = true;
 
 	if (p->l.t != BC_LEX_SCOLON) {
 		uint8_t flags = (BC_PARSE_REL | BC_PARSE_NEEDVAL);
@@ -714,7 +1000,7 @@ static void bc_parse_for(BcParse *p) {
 		// This is safe to set because the current token
 		// is a semicolon, which has no string requirement.
 		bc_vec_string(&p->l.str, sizeof(bc_parse_one) - 1, bc_parse_one);
-		bc_parse_number(p);
+		bc_parse_const(p);
 
 		bc_parse_err(p, BC_ERR_POSIX_FOR);
 	}
@@ -724,8 +1010,18 @@ static void bc_parse_for(BcParse *p) {
 
 	bc_lex_next(&p->l);
 
-	bc_parse_push(p, BC_INST_JUMP_ZERO);
-	bc_parse_pushIndex(p, exit_idx);
+	cond = bc_parse_constVal(p, start);
+
+	// This is like in bc_parse_while().
+	if (cond != NULL) {
+		if (!bc_num_cmpZero(cond)) len = start + 1;
+		bc_parse_truncate(p, start);
+	}
+	else {
+		bc_parse_push(p, BC_INST_JUMP_ZERO);
+		bc_parse_pushIndex(p, exit_idx);
+	}
+
 	bc_parse_push(p, BC_INST_JUMP);
 	bc_parse_pushIndex(p, body_idx);
 
@@ -735,6 +1031,8 @@ static void bc_parse_for(BcParse *p) {
 		bc_parse_expr_status(p, 0, bc_parse_next_rel);
 	else bc_parse_err(p, BC_ERR_POSIX_FOR);
 
+	p->loop = false;
+
 	if (BC_ERR(p->l.t != BC_LEX_RPAREN))
 		bc_parse_err(p, BC_ERR_PARSE_TOKEN);
 	bc_parse_push(p, BC_INST_JUMP);
@@ -742,6 +1040,7 @@ static void bc_parse_for(BcParse *p) {
 	bc_parse_createLabel(p, p->func->code.len);
 
 	bc_parse_createExitLabel(p, exit_idx, true);
+	((BcInstPtr*) bc_vec_top(&p->exits))->len = len;
 	bc_lex_next(&p->l);
 	bc_parse_startBody(p, BC_PARSE_FLAG_LOOP | BC_PARSE_FLAG_LOOP_INNER);
 }
@@ -768,6 +1067,7 @@ static void bc_parse_loopExit(BcParse *p, BcLexType type) {
 
 	bc_parse_push(p, BC_INST_JUMP);
 	bc_parse_pushIndex(p, i);
+	bc_parse_setDead(p);
 
 	bc_lex_next(&p->l);
 }
@@ -1180,6 +1480,8 @@ static BcParseStatus bc_parse_expr_err(BcParse *p, uint8_t flags,
 
 	pfirst = (p->l.t == BC_LEX_LPAREN);
 	nparens = nrelops = 0;
+
+	bc_vec_popAll(&p->folds);
 	rprn = done = get_token = assign = incdec = can_assign = false;
 	bin_last = true;
 
@@ -1345,7 +1647,7 @@ static BcParseStatus bc_parse_expr_err(BcParse *p, uint8_t flags,
 				if (BC_ERR(BC_PARSE_LEAF(prev, bin_last, rprn)))
 					bc_parse_err(p, BC_ERR_PARSE_EXPR);
 
-				bc_parse_number(p);
+				bc_parse_const(p);
 				nexprs += 1;
 				prev = BC_INST_NUM;
 				get_token = true;
@@ -1368,6 +1670,8 @@ static BcParseStatus bc_parse_expr_err(BcParse *p, uint8_t flags,
 				prev = t - BC_LEX_KW_LAST + BC_INST_LAST;
 				bc_parse_push(p, prev);
 
+				if (t == BC_LEX_KW_IBASE) p->ibase = true;
+
 				get_token = can_assign = true;
 				rprn = bin_last = false;
 				nexprs += 1;
@@ -1414,6 +1718,9 @@ static BcParseStatus bc_parse_expr_err(BcParse *p, uint8_t flags,
 					bc_parse_noArgBuiltin(p, prev);
 				}
 
+				// What read() parses could set ibase.
+				if (t == BC_LEX_KW_READ) p->ibase = true;
+
 				rprn = get_token = bin_last = incdec = can_assign = false;
 				nexprs += 1;
 				flags &= ~(BC_PARSE_ARRAY);
@@ -1454,7 +1761,7 @@ static BcParseStatus bc_parse_expr_err(BcParse *p, uint8_t flags,
 		if (BC_ERR(top == BC_LEX_LPAREN || top == BC_LEX_RPAREN))
 			bc_parse_err(p, BC_ERR_PARSE_EXPR);
 
-		bc_parse_push(p, BC_PARSE_TOKEN_INST(top));
+		bc_parse_op(p, BC_PARSE_TOKEN_INST(top));
 
 		nexprs -= !BC_PARSE_OP_PREFIX(top);
 		bc_vec_pop(&p->ops);
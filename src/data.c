@@ -636,6 +636,7 @@ const char* bc_inst_names[] = {
 	"BC_INST_JUMP_ZERO",
 
 	"BC_INST_CALL",
+	"BC_INST_TAIL_CALL",
 
 	"BC_INST_RET",
 	"BC_INST_RET0",
@@ -669,6 +670,18 @@ const char* bc_inst_names[] = {
 	"BC_INST_QUIT",
 	"BC_INST_NQUIT",
 #endif // DC_ENABLED
+
+#if BC_ENABLED
+	"BC_INST_JUMP_REL",
+	"BC_INST_VAR_OP",
+	"BC_INST_VAR_OP_ASSIGN",
+	"BC_INST_OP_ASSIGN",
+	"BC_INST_ASSIGN_VAR",
+
+	"BC_INST_EXPR",
+	"BC_INST_EXPR_ASSIGN",
+	"BC_INST_EXPR_JUMP",
+#endif // BC_ENABLED
 };
 #endif // BC_DEBUG_CODE
 
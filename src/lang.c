@@ -56,10 +56,11 @@ void bc_string_free(void *string) {
 
 void bc_const_free(void *constant) {
 	BcConst *c = constant;
+	size_t i;
 	BC_SIG_ASSERT_LOCKED;
 	assert(c->val != NULL);
 	free(c->val);
-	bc_num_free(&c->num);
+	for (i = 0; i < BC_CONST_BASES; ++i) bc_num_free(&c->num[i]);
 }
 
 #if BC_ENABLED
@@ -95,6 +96,8 @@ void bc_func_init(BcFunc *f, const char *name) {
 	assert(f != NULL && name != NULL);
 
 	bc_vec_init(&f->code, sizeof(uchar), NULL);
+	bc_vec_init(&f->insts, sizeof(size_t), NULL);
+	f->decoded = 0;
 
 	bc_vec_init(&f->consts, sizeof(BcConst), bc_const_free);
 
@@ -103,6 +106,7 @@ void bc_func_init(BcFunc *f, const char *name) {
 
 		bc_vec_init(&f->strs, sizeof(char*), bc_string_free);
 
+		bc_vec_init(&f->ir, sizeof(BcRegOp), NULL);
 		bc_vec_init(&f->autos, sizeof(BcLoc), NULL);
 		bc_vec_init(&f->labels, sizeof(size_t), NULL);
 
@@ -119,7 +123,7 @@ void bc_func_reset(BcFunc *f) {
 	BC_SIG_ASSERT_LOCKED;
 	assert(f != NULL);
 
-	bc_vec_popAll(&f->code);
+	bc_func_clearCode(f);
 
 	bc_vec_popAll(&f->consts);
 
@@ -137,6 +141,19 @@ void bc_func_reset(BcFunc *f) {
 #endif // BC_ENABLED
 }
 
+void bc_func_clearCode(BcFunc *f) {
+
+	assert(f != NULL);
+
+	bc_vec_popAll(&f->code);
+	bc_vec_popAll(&f->insts);
+	f->decoded = 0;
+
+#if BC_ENABLED
+	if (BC_IS_BC) bc_vec_popAll(&f->ir);
+#endif // BC_ENABLED
+}
+
 void bc_func_free(void *func) {
 
 #if BC_ENABLE_FUNC_FREE
@@ -147,6 +164,7 @@ void bc_func_free(void *func) {
 	assert(f != NULL);
 
 	bc_vec_free(&f->code);
+	bc_vec_free(&f->insts);
 
 	bc_vec_free(&f->consts);
 
@@ -156,6 +174,7 @@ void bc_func_free(void *func) {
 
 		bc_vec_free(&f->strs);
 
+		bc_vec_free(&f->ir);
 		bc_vec_free(&f->autos);
 		bc_vec_free(&f->labels);
 	}
@@ -189,7 +208,7 @@ void bc_array_copy(BcVec *d, const BcVec *s) {
 
 	for (i = 0; i < s->len; ++i) {
 		BcNum *dnum = bc_vec_item(d, i), *snum = bc_vec_item(s, i);
-		bc_num_createCopy(dnum, snum);
+		bc_num_share(dnum, snum);
 	}
 }
 
@@ -242,7 +261,7 @@ void bc_result_copy(BcResult *d, BcResult *src) {
 		case BC_RESULT_SEED:
 #endif // BC_ENABLE_EXTRA_MATH
 		{
-			bc_num_createCopy(&d->d.n, &src->d.n);
+			bc_num_share(&d->d.n, &src->d.n);
 			break;
 		}
 
@@ -45,7 +45,16 @@
 #include <rand.h>
 #include <vm.h>
 
-static void bc_num_m(BcNum *a, BcNum *b, BcNum *restrict c, size_t scale);
+#if BC_NUM_SIMD
+#ifdef __x86_64__
+#include <immintrin.h>
+#else // __x86_64__
+#include <arm_neon.h>
+#endif // __x86_64__
+#endif // BC_NUM_SIMD
+
+static void bc_num_k(BcNum *a, BcNum *b, BcNum *restrict c,
+                     BcDig *restrict scratch);
 
 static inline ssize_t bc_num_neg(size_t n, bool neg) {
 	return (((ssize_t) n) ^ -((ssize_t) neg)) + neg;
@@ -59,17 +68,150 @@ static inline size_t bc_num_int(const BcNum *n) {
 	return n->len ? n->len - BC_NUM_RDX_VAL(n) : 0;
 }
 
+// Returns the pool size class for cap, or BC_NUM_POOL_CLASSES if it is too
+// big to pool.
+static size_t bc_num_poolClass(size_t cap) {
+
+	size_t i = 0;
+
+	while (i < BC_NUM_POOL_CLASSES && (((size_t) BC_NUM_DEF_SIZE) << i) < cap)
+		i += 1;
+
+	return i;
+}
+
+// The reference count is stored just in front of the digits.
+static inline size_t* bc_num_refs(const BcDig *num) {
+	return ((size_t*) num) - 1;
+}
+
+// Whether the digits must be copied before they are changed.
+static inline bool bc_num_shared(const BcNum *restrict n) {
+	return n->ref && *bc_num_refs(n->num) > 1;
+}
+
+// Allocates digits with a reference count of 1, from the pool if it can. cap is
+// rounded up to the size of its class.
+static BcDig* bc_num_alloc(size_t *restrict cap) {
+
+	size_t *ptr;
+	size_t i = bc_num_poolClass(*cap);
+
+	BC_SIG_ASSERT_LOCKED;
+
+	if (i == BC_NUM_POOL_CLASSES)
+		ptr = bc_vm_malloc(bc_vm_growSize(BC_NUM_SIZE(*cap), sizeof(size_t)));
+	else {
+
+		*cap = ((size_t) BC_NUM_DEF_SIZE) << i;
+		ptr = vm.pool[i];
+
+		if (ptr != NULL) {
+
+			// The next array in the list is stored in the first bytes of this
+			// one.
+			memcpy(&vm.pool[i], ptr, sizeof(void*));
+
+			vm.pool_size -= BC_NUM_SIZE(*cap);
+			vm.pool_hits += 1;
+		}
+		else {
+			ptr = bc_vm_malloc(BC_NUM_SIZE(*cap) + sizeof(size_t));
+			vm.pool_misses += 1;
+		}
+	}
+
+	*ptr = 1;
+
+	return (BcDig*) (ptr + 1);
+}
+
+// Returns unshared digits to the pool, or frees them if they are too big or the
+// pool is full.
+static void bc_num_dealloc(BcDig *num, size_t cap) {
+
+	size_t *ptr = bc_num_refs(num);
+	size_t i = bc_num_poolClass(cap);
+
+	BC_SIG_ASSERT_LOCKED;
+
+	assert(*ptr == 1);
+
+	if (i == BC_NUM_POOL_CLASSES ||
+	    vm.pool_size + BC_NUM_SIZE(cap) > BC_NUM_POOL_MAX)
+	{
+		free(ptr);
+		return;
+	}
+
+	assert(cap == ((size_t) BC_NUM_DEF_SIZE) << i);
+
+	memcpy(ptr, &vm.pool[i], sizeof(void*));
+	vm.pool[i] = ptr;
+	vm.pool_size += BC_NUM_SIZE(cap);
+}
+
+// Gives n its own copy of its shared digits, with room for cap digits.
+static void bc_num_unshare(BcNum *restrict n, size_t cap) {
+
+	BcDig *num;
+	sig_atomic_t lock;
+
+	assert(bc_num_shared(n) && cap >= n->len);
+
+	BC_SIG_TRYLOCK(lock);
+
+	num = bc_num_alloc(&cap);
+	memcpy(num, n->num, BC_NUM_SIZE(n->len));
+
+	*bc_num_refs(n->num) -= 1;
+
+	n->num = num;
+	n->cap = cap;
+
+	BC_SIG_TRYUNLOCK(lock);
+}
+
+// Called before anything writes to digits without bc_num_expand().
+static inline void bc_num_own(BcNum *restrict n) {
+	if (bc_num_shared(n)) bc_num_unshare(n, n->cap);
+}
+
 static void bc_num_expand(BcNum *restrict n, size_t req) {
 
+	BcDig *num;
+	size_t *ptr;
+
 	assert(n != NULL);
 
 	req = req >= BC_NUM_DEF_SIZE ? req : BC_NUM_DEF_SIZE;
 
-	if (req > n->cap) {
+	if (bc_num_shared(n)) bc_num_unshare(n, BC_MAX(req, n->cap));
+	else if (req > n->cap) {
 
 		BC_SIG_LOCK;
 
-		n->num = bc_vm_realloc(n->num, BC_NUM_SIZE(req));
+		// Arrays too big for the pool can only grow into arrays that are also
+		// too big, so those can still be realloc()'ed.
+		if (n->ref && bc_num_poolClass(n->cap) == BC_NUM_POOL_CLASSES) {
+			ptr = bc_vm_realloc(bc_num_refs(n->num),
+			                    bc_vm_growSize(BC_NUM_SIZE(req), sizeof(size_t)));
+			n->num = (BcDig*) (ptr + 1);
+		}
+		else {
+
+			num = bc_num_alloc(&req);
+
+			if (n->num != NULL) {
+				assert(n->ref);
+				memcpy(num, n->num, BC_NUM_SIZE(n->cap));
+				bc_num_dealloc(n->num, n->cap);
+			}
+
+			n->num = num;
+			n->ref = true;
+		}
+
 		n->cap = req;
 
 		BC_SIG_UNLOCK;
@@ -87,6 +229,7 @@ void bc_num_zero(BcNum *restrict n) {
 }
 
 void bc_num_one(BcNum *restrict n) {
+	bc_num_own(n);
 	bc_num_zero(n);
 	n->len = 1;
 	n->num[0] = 1;
@@ -136,9 +279,11 @@ static BcDig bc_num_addDigits(BcDig a, BcDig b, bool *carry) {
 	assert(a < BC_BASE_POW);
 	assert(b < BC_BASE_POW);
 
+	// The carry is applied with a multiplication instead of a branch because
+	// it is as likely as not, so a branch would be mispredicted half the time.
 	a += b + *carry;
 	*carry = (a >= BC_BASE_POW);
-	if (*carry) a -= BC_BASE_POW;
+	a -= ((BcDig) *carry) * BC_BASE_POW;
 
 	assert(a >= 0);
 	assert(a < BC_BASE_POW);
@@ -153,7 +298,7 @@ static BcDig bc_num_subDigits(BcDig a, BcDig b, bool *carry) {
 
 	b += *carry;
 	*carry = (a < b);
-	if (*carry) a += BC_BASE_POW;
+	a += ((BcDig) *carry) * BC_BASE_POW;
 
 	assert(a - b >= 0);
 	assert(a - b < BC_BASE_POW);
@@ -161,8 +306,8 @@ static BcDig bc_num_subDigits(BcDig a, BcDig b, bool *carry) {
 	return a - b;
 }
 
-static void bc_num_addArrays(BcDig *restrict a, const BcDig *restrict b,
-                             size_t len)
+static void bc_num_addArraysC(BcDig *restrict a, const BcDig *restrict b,
+                              size_t len)
 {
 	size_t i;
 	bool carry = false;
@@ -172,8 +317,8 @@ static void bc_num_addArrays(BcDig *restrict a, const BcDig *restrict b,
 	for (; carry; ++i) a[i] = bc_num_addDigits(a[i], 0, &carry);
 }
 
-static void bc_num_subArrays(BcDig *restrict a, const BcDig *restrict b,
-                             size_t len)
+static void bc_num_subArraysC(BcDig *restrict a, const BcDig *restrict b,
+                              size_t len)
 {
 	size_t i;
 	bool carry = false;
@@ -183,11 +328,48 @@ static void bc_num_subArrays(BcDig *restrict a, const BcDig *restrict b,
 	for (; carry; ++i) a[i] = bc_num_subDigits(a[i], 0, &carry);
 }
 
+static BcBigDig bc_num_mulDigitsC(BcDig *restrict c,
+                                  const BcDig *restrict a, size_t len,
+                                  BcBigDig b)
+{
+	size_t i;
+	BcBigDig hi = 0;
+	bool carry = false;
+
+	// The high half of each product is added to the next digit, but it is not
+	// carried through the product itself; only a one-bit carry goes from digit
+	// to digit. That way, the multiplications and the divisions by
+	// BC_BASE_POW do not depend on each other and can overlap.
+	for (i = 0; i < len; ++i) {
+		BcBigDig in = ((BcBigDig) a[i]) * b;
+		c[i] = bc_num_addDigits((BcDig) (in % BC_BASE_POW), (BcDig) hi,
+		                        &carry);
+		hi = in / BC_BASE_POW;
+	}
+
+	return hi + carry;
+}
+
+static ssize_t bc_num_compareC(const BcDig *restrict a, const BcDig *restrict b,
+                               size_t len)
+{
+	size_t i;
+	BcDig c = 0;
+	for (i = len - 1; i < len && !(c = a[i] - b[i]); --i);
+	return bc_num_neg(i + 1, c < 0);
+}
+
+// The limb kernels that have SIMD versions. They start as the portable ones,
+// and bc_num_simdInit() switches them to the best ones for the CPU.
+static BcNumShiftAddOp bc_num_addArrays = bc_num_addArraysC;
+static BcNumShiftAddOp bc_num_subArrays = bc_num_subArraysC;
+static BcNumMulDigitsOp bc_num_mulDigits = bc_num_mulDigitsC;
+static BcNumCmpOp bc_num_compare = bc_num_compareC;
+
 static void bc_num_mulArray(const BcNum *restrict a, BcBigDig b,
                             BcNum *restrict c)
 {
-	size_t i;
-	BcBigDig carry = 0;
+	BcBigDig hi;
 
 	assert(b <= BC_BASE_POW);
 
@@ -195,16 +377,12 @@ static void bc_num_mulArray(const BcNum *restrict a, BcBigDig b,
 
 	memset(c->num, 0, BC_NUM_SIZE(c->cap));
 
-	for (i = 0; i < a->len; ++i) {
-		BcBigDig in = ((BcBigDig) a->num[i]) * b + carry;
-		c->num[i] = in % BC_BASE_POW;
-		carry = in / BC_BASE_POW;
-	}
+	hi = bc_num_mulDigits(c->num, a->num, a->len, b);
 
-	assert(carry < BC_BASE_POW);
-	c->num[i] = (BcDig) carry;
+	assert(hi < BC_BASE_POW);
+	c->num[a->len] = (BcDig) hi;
 	c->len = a->len;
-	c->len += (carry != 0);
+	c->len += (hi != 0);
 
 	bc_num_clean(c);
 
@@ -237,15 +415,6 @@ static void bc_num_divArray(const BcNum *restrict a, BcBigDig b,
 	assert(!c->len || c->num[c->len - 1] || BC_NUM_RDX_VAL(c) == c->len);
 }
 
-static ssize_t bc_num_compare(const BcDig *restrict a, const BcDig *restrict b,
-                              size_t len)
-{
-	size_t i;
-	BcDig c = 0;
-	for (i = len - 1; i < len && !(c = a[i] - b[i]); --i);
-	return bc_num_neg(i + 1, c < 0);
-}
-
 ssize_t bc_num_cmp(const BcNum *a, const BcNum *b) {
 
 	size_t i, min, a_int, b_int, diff, ardx, brdx;
@@ -315,6 +484,8 @@ void bc_num_truncate(BcNum *restrict n, size_t places) {
 
 		size_t pow;
 
+		bc_num_own(n);
+
 		pow = n->scale % BC_BASE_DIGS;
 		pow = pow ? BC_BASE_DIGS - pow : 0;
 		pow = bc_num_pow10[pow];
@@ -365,33 +536,6 @@ static void bc_num_retireMul(BcNum *restrict n, size_t scale,
 	if (BC_NUM_NONZERO(n)) n->rdx = BC_NUM_NEG_VAL(n, !neg1 != !neg2);
 }
 
-static void bc_num_split(const BcNum *restrict n, size_t idx,
-                         BcNum *restrict a, BcNum *restrict b)
-{
-	assert(BC_NUM_ZERO(a));
-	assert(BC_NUM_ZERO(b));
-
-	if (idx < n->len) {
-
-		b->len = n->len - idx;
-		a->len = idx;
-		a->scale = b->scale = 0;
-		BC_NUM_RDX_SET(a, 0);
-		BC_NUM_RDX_SET(b, 0);
-
-		assert(a->cap >= a->len);
-		assert(b->cap >= b->len);
-
-		memcpy(b->num, n->num + idx, BC_NUM_SIZE(b->len));
-		memcpy(a->num, n->num, BC_NUM_SIZE(idx));
-
-		bc_num_clean(b);
-	}
-	else bc_num_copy(a, n);
-
-	bc_num_clean(a);
-}
-
 static size_t bc_num_shiftZero(BcNum *restrict n) {
 
 	size_t i;
@@ -415,10 +559,13 @@ static void bc_num_shift(BcNum *restrict n, BcBigDig dig) {
 
 	size_t i, len = n->len;
 	BcBigDig carry = 0, pow;
-	BcDig *ptr = n->num;
+	BcDig *ptr;
 
 	assert(dig < BC_BASE_DIGS);
 
+	bc_num_own(n);
+	ptr = n->num;
+
 	pow = bc_num_pow10[dig];
 	dig = bc_num_pow10[BC_BASE_DIGS - dig];
 
@@ -566,7 +713,39 @@ static void bc_num_intop(const BcNum *a, const BcNum *b, BcNum *restrict c,
 }
 #endif // BC_ENABLE_EXTRA_MATH
 
-static void bc_num_as(BcNum *a, BcNum *b, BcNum *restrict c, size_t sub) {
+// Returns the magnitude of an integer of at most two limbs. Two limbs always
+// fit in a BcBigDig with room for a carry.
+static inline BcBigDig bc_num_small(const BcNum *restrict n) {
+	assert(n->len <= 2 && !BC_NUM_RDX_VAL(n));
+	return n->len == 2 ? (BcBigDig) n->num[1] * BC_BASE_POW + n->num[0] :
+	                     (BcBigDig) n->num[0];
+}
+
+// The fast path of bc_num_as() for integers of at most two limbs, which loop
+// counters and indices almost always are.
+static void bc_num_asSmall(BcNum *a, BcNum *b, BcNum *c, bool sub) {
+
+	BcBigDig x = bc_num_small(a), y = bc_num_small(b);
+	bool neg = BC_NUM_NEG(a);
+	size_t i;
+
+	if (!sub) x += y;
+	else if (x >= y) x -= y;
+	else {
+		x = y - x;
+		neg = !neg;
+	}
+
+	for (i = 0; x; ++i, x /= BC_BASE_POW) c->num[i] = x % BC_BASE_POW;
+
+	assert(i <= c->cap);
+
+	c->len = i;
+	c->scale = 0;
+	BC_NUM_RDX_SET_NEG(c, 0, neg && i);
+}
+
+static void bc_num_as(BcNum *a, BcNum *b, BcNum *c, size_t sub) {
 
 	BcDig *ptr_c, *ptr_l, *ptr_r;
 	size_t i, min_rdx, max_rdx, diff, a_int, b_int, min_len, max_len, max_int;
@@ -594,6 +773,12 @@ static void bc_num_as(BcNum *a, BcNum *b, BcNum *restrict c, size_t sub) {
 	// Actually add the numbers if their signs are equal, else subtract.
 	do_sub = (BC_NUM_NEG(a) != b_neg);
 
+	if (a->len <= 2 && b->len <= 2 && !BC_NUM_RDX_VAL(a) && !BC_NUM_RDX_VAL(b))
+	{
+		bc_num_asSmall(a, b, c, do_sub);
+		return;
+	}
+
 	a_int = bc_num_int(a);
 	b_int = bc_num_int(b);
 	max_int = BC_MAX(a_int, b_int);
@@ -651,7 +836,8 @@ static void bc_num_as(BcNum *a, BcNum *b, BcNum *restrict c, size_t sub) {
 			// !do_rev_sub && ardx > brdx || do_rev_sub && brdx > ardx
 			// The left operand has BcDig values that need to be copied,
 			// either from a or from b (in case of a reversed subtraction).
-			memcpy(ptr_c, ptr_l, BC_NUM_SIZE(diff));
+			// They are already in place if c is a.
+			if (ptr_c != ptr_l) memcpy(ptr_c, ptr_l, BC_NUM_SIZE(diff));
 			ptr_l += diff;
 			len_l -= diff;
 		}
@@ -669,7 +855,7 @@ static void bc_num_as(BcNum *a, BcNum *b, BcNum *restrict c, size_t sub) {
 			else {
 
 				// !do_sub && brdx > ardx
-				memcpy(ptr_c, ptr_r, BC_NUM_SIZE(diff));
+				if (ptr_c != ptr_r) memcpy(ptr_c, ptr_r, BC_NUM_SIZE(diff));
 			}
 
 			ptr_r += diff;
@@ -711,261 +897,1594 @@ static void bc_num_as(BcNum *a, BcNum *b, BcNum *restrict c, size_t sub) {
 	bc_num_clean(c);
 }
 
-static void bc_num_m_simp(const BcNum *a, const BcNum *b, BcNum *restrict c)
-{
-	size_t i, alen = a->len, blen = b->len, clen;
-	BcDig *ptr_a = a->num, *ptr_b = b->num, *ptr_c;
-	BcBigDig sum = 0, carry = 0;
-
-	assert(sizeof(sum) >= sizeof(BcDig) * 2);
-	assert(!BC_NUM_RDX_VAL(a) && !BC_NUM_RDX_VAL(b));
-
-	clen = bc_vm_growSize(alen, blen);
-	bc_num_expand(c, bc_vm_growSize(clen, 1));
-
-	ptr_c = c->num;
-	memset(ptr_c, 0, BC_NUM_SIZE(c->cap));
-
-	for (i = 0; i < clen; ++i) {
-
-		ssize_t sidx = (ssize_t) (i - blen + 1);
-		size_t j = (size_t) BC_MAX(0, sidx), k = BC_MIN(i, blen - 1);
+// Adds or subtracts b to or from a in place, if the digits of a are not
+// shared, have the capacity for the result, and the rdx does not have to move.
+// Returns false, without doing anything, otherwise.
+static bool bc_num_asInPlace(BcNum *a, BcNum *b, bool sub) {
 
-		for (; j < alen && k < blen; ++j, --k) {
+	size_t i;
 
-			sum += ((BcBigDig) ptr_a[j]) * ((BcBigDig) ptr_b[k]);
+	if (a == b || bc_num_shared(a) || BC_NUM_RDX_VAL(a) < BC_NUM_RDX_VAL(b))
+		return false;
 
-			if (sum >= ((BcBigDig) BC_BASE_POW) * BC_BASE_POW) {
-				carry += sum / BC_BASE_POW;
-				sum %= BC_BASE_POW;
-			}
-		}
+	// Adding one to a number of the same sign, as in a loop counter, only has
+	// to carry as far as the nines go.
+	if (BC_NUM_ONE(b) && BC_NUM_NONZERO(a) && BC_NUM_NEG(a) == sub &&
+	    a->len < a->cap)
+	{
+		for (i = BC_NUM_RDX_VAL(a);
+		     i < a->len && a->num[i] == (BcDig) (BC_BASE_POW - 1); ++i)
+			a->num[i] = 0;
 
-		if (sum >= BC_BASE_POW) {
-			carry += sum / BC_BASE_POW;
-			sum %= BC_BASE_POW;
-		}
+		if (i < a->len) a->num[i] += 1;
+		else a->num[a->len++] = 1;
 
-		ptr_c[i] = (BcDig) sum;
-		assert(ptr_c[i] < BC_BASE_POW);
-		sum = carry;
-		carry = 0;
+		return true;
 	}
 
-	// This should always be true because there should be no carry on the last
-	// digit; multiplication never goes above the sum of both lengths.
-	assert(!sum);
+	if (a->cap < bc_num_addReq(a, b, 0)) return false;
 
-	c->len = clen;
+	bc_num_as(a, b, a, sub);
+
+	return true;
 }
 
-static void bc_num_shiftAddSub(BcNum *restrict n, const BcNum *restrict a,
-                               size_t shift, BcNumShiftAddOp op)
+// This adds v to the column sum hi * (BC_NUM_BIGDIG_MAX + 1) + lo.
+static inline void bc_num_colAdd(BcBigDig *restrict lo, BcBigDig *restrict hi,
+                                 BcBigDig v)
 {
-	assert(n->len >= shift + a->len);
-	assert(!BC_NUM_RDX_VAL(n) && !BC_NUM_RDX_VAL(a));
-	op(n->num + shift, a->num, a->len);
+	*lo += v;
+	*hi += (*lo < v);
 }
 
-static void bc_num_k(BcNum *a, BcNum *b, BcNum *restrict c) {
-
-	size_t max, max2, total;
-	BcNum l1, h1, l2, h2, m2, m1, z0, z1, z2, temp;
-	BcDig *digs, *dig_ptr;
-	BcNumShiftAddOp op;
-	bool aone = BC_NUM_ONE(a);
+// This returns the low digit of a column sum and puts the rest in carry. A
+// column has fewer than BC_BASE_POW products, and its carry in is less than
+// BC_BASE_POW^2, so hi is small enough that nothing here overflows.
+static inline BcDig bc_num_colNorm(BcBigDig lo, BcBigDig hi,
+                                   BcBigDig *restrict carry)
+{
+	BcBigDig r = lo % BC_BASE_POW + hi * BC_NUM_COL_MOD;
 
-	assert(BC_NUM_ZERO(c));
+	*carry = hi * BC_NUM_COL_DIV + lo / BC_BASE_POW + r / BC_BASE_POW;
 
-	if (BC_NUM_ZERO(a) || BC_NUM_ZERO(b)) return;
-	if (aone || BC_NUM_ONE(b)) {
-		bc_num_copy(c, aone ? b : a);
-		if ((aone && BC_NUM_NEG(a)) || BC_NUM_NEG(b)) BC_NUM_NEG_TGL(c);
-		return;
-	}
-	if (a->len < BC_NUM_KARATSUBA_LEN || b->len < BC_NUM_KARATSUBA_LEN) {
-		bc_num_m_simp(a, b, c);
-		return;
-	}
+	return (BcDig) (r % BC_BASE_POW);
+}
 
-	max = BC_MAX(a->len, b->len);
-	max = BC_MAX(max, BC_NUM_DEF_SIZE);
-	max2 = (max + 1) / 2;
+#if BC_NUM_WIDE
 
-	total = bc_vm_arraySize(BC_NUM_KARATSUBA_ALLOCS, max);
+static BcBigDig bc_num_wideDig(const BcDig *restrict n, size_t len, size_t i) {
 
-	BC_SIG_LOCK;
+	BcBigDig dig = (BcBigDig) n[2 * i];
 
-	digs = dig_ptr = bc_vm_malloc(BC_NUM_SIZE(total));
-
-	bc_num_setup(&l1, dig_ptr, max);
-	dig_ptr += max;
-	bc_num_setup(&h1, dig_ptr, max);
-	dig_ptr += max;
-	bc_num_setup(&l2, dig_ptr, max);
-	dig_ptr += max;
-	bc_num_setup(&h2, dig_ptr, max);
-	dig_ptr += max;
-	bc_num_setup(&m1, dig_ptr, max);
-	dig_ptr += max;
-	bc_num_setup(&m2, dig_ptr, max);
-	max = bc_vm_growSize(max, 1);
-	bc_num_init(&z0, max);
-	bc_num_init(&z1, max);
-	bc_num_init(&z2, max);
-	max = bc_vm_growSize(max, max) + 1;
-	bc_num_init(&temp, max);
+	// This returns digit i of n in BC_NUM_WIDE_POW, which is made from the
+	// digits at 2 * i and 2 * i + 1.
+	if (2 * i + 1 < len) dig += ((BcBigDig) n[2 * i + 1]) * BC_BASE_POW;
 
-	BC_SETJMP_LOCKED(err);
+	return dig;
+}
 
-	BC_SIG_UNLOCK;
+static void bc_num_wideSet(BcDig *restrict c, size_t clen, size_t i,
+                           BcWideDig dig)
+{
+	BcBigDig d = (BcBigDig) dig;
 
-	bc_num_split(a, max2, &l1, &h1);
-	bc_num_split(b, max2, &l2, &h2);
+	assert(dig < BC_NUM_WIDE_POW);
 
-	bc_num_expand(c, max);
-	c->len = max;
-	memset(c->num, 0, BC_NUM_SIZE(c->len));
+	// This splits a wide digit back into the digits at 2 * i and 2 * i + 1.
+	// The ones past the end must be zero because a product cannot be longer
+	// than both operands together.
+	if (2 * i < clen) c[2 * i] = (BcDig) (d % BC_BASE_POW);
+	else assert(!(d % BC_BASE_POW));
 
-	bc_num_sub(&h1, &l1, &m1, 0);
-	bc_num_sub(&l2, &h2, &m2, 0);
+	if (2 * i + 1 < clen) c[2 * i + 1] = (BcDig) (d / BC_BASE_POW);
+	else assert(!(d / BC_BASE_POW));
+}
 
-	if (BC_NUM_NONZERO(&h1) && BC_NUM_NONZERO(&h2)) {
+static void bc_num_m_simp(const BcNum *a, const BcNum *b, BcNum *restrict c)
+{
+	BcBigDig w[(BC_NUM_KARATSUBA_LEN + 1) / 2];
+	const BcNum *shrt = a->len <= b->len ? a : b, *lng = shrt == a ? b : a;
+	size_t i, slen = (shrt->len + 1) / 2, llen = (lng->len + 1) / 2, clen;
+	BcWideDig sum, carry = 0;
 
-		assert(BC_NUM_RDX_VALID_NP(h1));
-		assert(BC_NUM_RDX_VALID_NP(h2));
+	assert(shrt->len < BC_NUM_KARATSUBA_LEN);
+	assert(!BC_NUM_RDX_VAL(a) && !BC_NUM_RDX_VAL(b));
 
-		bc_num_m(&h1, &h2, &z2, 0);
-		bc_num_clean(&z2);
+	clen = bc_vm_growSize(a->len, b->len);
+	bc_num_expand(c, bc_vm_growSize(clen, 1));
+	memset(c->num, 0, BC_NUM_SIZE(c->cap));
 
-		bc_num_shiftAddSub(c, &z2, max2 * 2, bc_num_addArrays);
-		bc_num_shiftAddSub(c, &z2, max2, bc_num_addArrays);
-	}
+	// This is the same column-wise product as the other bc_num_m_simp(), but
+	// with digits of BC_NUM_WIDE_POW, so it only does a quarter of the
+	// products. The short operand is always short enough to be converted up
+	// front; the long one is converted as it goes. A whole column fits in a
+	// BcWideDig, so it is only split once, at the end.
+	for (i = 0; i < slen; ++i) w[i] = bc_num_wideDig(shrt->num, shrt->len, i);
 
-	if (BC_NUM_NONZERO(&l1) && BC_NUM_NONZERO(&l2)) {
+	for (i = 0; i < slen + llen; ++i) {
 
-		assert(BC_NUM_RDX_VALID_NP(l1));
-		assert(BC_NUM_RDX_VALID_NP(l2));
+		size_t j = i < llen ? 0 : i - llen + 1, k = i - j;
+		size_t end = j + BC_MIN(slen - BC_MIN(j, slen), k + 1);
 
-		bc_num_m(&l1, &l2, &z0, 0);
-		bc_num_clean(&z0);
+		for (sum = carry; j < end; ++j, --k) {
+			BcBigDig dig = bc_num_wideDig(lng->num, lng->len, k);
+			sum += ((BcWideDig) w[j]) * dig;
+		}
 
-		bc_num_shiftAddSub(c, &z0, max2, bc_num_addArrays);
-		bc_num_shiftAddSub(c, &z0, 0, bc_num_addArrays);
+		carry = sum / BC_NUM_WIDE_POW;
+		bc_num_wideSet(c->num, clen, i, sum % BC_NUM_WIDE_POW);
 	}
 
-	if (BC_NUM_NONZERO(&m1) && BC_NUM_NONZERO(&m2)) {
-
-		assert(BC_NUM_RDX_VALID_NP(m1));
-		assert(BC_NUM_RDX_VALID_NP(m1));
-
-		bc_num_m(&m1, &m2, &z1, 0);
-		bc_num_clean(&z1);
-
-		op = (BC_NUM_NEG_NP(m1) != BC_NUM_NEG_NP(m2)) ?
-		     bc_num_subArrays : bc_num_addArrays;
-		bc_num_shiftAddSub(c, &z1, max2, op);
-	}
+	assert(!carry);
 
-err:
-	BC_SIG_MAYLOCK;
-	free(digs);
-	bc_num_free(&temp);
-	bc_num_free(&z2);
-	bc_num_free(&z1);
-	bc_num_free(&z0);
-	BC_LONGJMP_CONT;
+	c->len = clen;
 }
 
-static void bc_num_m(BcNum *a, BcNum *b, BcNum *restrict c, size_t scale) {
+static void bc_num_s_simp(const BcNum *a, BcNum *restrict c) {
 
-	BcNum cpa, cpb;
-	size_t ascale, bscale, ardx, brdx, azero = 0, bzero = 0, zero, len, rscale;
+	BcBigDig w[(BC_NUM_KARATSUBA_LEN + 1) / 2];
+	size_t i, alen = (a->len + 1) / 2, clen;
+	BcWideDig sum, in = 0;
 
-	assert(BC_NUM_RDX_VALID(a));
-	assert(BC_NUM_RDX_VALID(b));
+	assert(a->len < BC_NUM_KARATSUBA_LEN);
+	assert(!BC_NUM_RDX_VAL(a));
 
-	bc_num_zero(c);
-	ascale = a->scale;
-	bscale = b->scale;
-	scale = BC_MAX(scale, ascale);
-	scale = BC_MAX(scale, bscale);
+	clen = bc_vm_growSize(a->len, a->len);
+	bc_num_expand(c, bc_vm_growSize(clen, 1));
+	memset(c->num, 0, BC_NUM_SIZE(c->cap));
 
-	rscale = ascale + bscale;
-	scale = BC_MIN(rscale, scale);
+	// This is the same as the other bc_num_s_simp(), but with digits of
+	// BC_NUM_WIDE_POW.
+	for (i = 0; i < alen; ++i) w[i] = bc_num_wideDig(a->num, a->len, i);
 
-	if ((a->len == 1 || b->len == 1) && !a->rdx && !b->rdx) {
+	for (i = 0; i < 2 * alen; ++i) {
 
-		BcNum *operand;
-		BcBigDig dig;
+		size_t j = i < alen ? 0 : i - alen + 1, k = i - j;
 
-		if (a->len == 1) {
-			dig = (BcBigDig) a->num[0];
-			operand = b;
-		}
-		else {
-			dig = (BcBigDig) b->num[0];
-			operand = a;
-		}
+		for (sum = 0; j < k; ++j, --k) sum += ((BcWideDig) w[j]) * w[k];
 
-		bc_num_mulArray(operand, dig, c);
+		sum *= 2;
 
-		if (BC_NUM_NONZERO(c))
-			c->rdx = BC_NUM_NEG_VAL(c, BC_NUM_NEG(a) != BC_NUM_NEG(b));
+		if (j == k) sum += ((BcWideDig) w[j]) * w[j];
 
-		return;
-	}
+		sum += in;
+		in = sum / BC_NUM_WIDE_POW;
 
-	assert(BC_NUM_RDX_VALID(a));
-	assert(BC_NUM_RDX_VALID(b));
+		bc_num_wideSet(c->num, clen, i, sum % BC_NUM_WIDE_POW);
+	}
 
-	BC_SIG_LOCK;
+	assert(!in);
 
-	bc_num_init(&cpa, a->len + BC_NUM_RDX_VAL(a));
-	bc_num_init(&cpb, b->len + BC_NUM_RDX_VAL(b));
+	c->len = clen;
+}
 
-	BC_SETJMP_LOCKED(err);
+#else // BC_NUM_WIDE
 
-	BC_SIG_UNLOCK;
+static void bc_num_m_simp(const BcNum *a, const BcNum *b, BcNum *restrict c)
+{
+	size_t i, alen = a->len, blen = b->len, clen;
+	BcDig *ptr_a = a->num, *ptr_b = b->num, *ptr_c;
+	BcBigDig lo, hi, carry = 0;
 
-	bc_num_copy(&cpa, a);
-	bc_num_copy(&cpb, b);
+	assert(sizeof(lo) >= sizeof(BcDig) * 2);
+	assert(!BC_NUM_RDX_VAL(a) && !BC_NUM_RDX_VAL(b));
+	assert(BC_MIN(alen, blen) < BC_NUM_KARATSUBA_LEN);
 
-	assert(BC_NUM_RDX_VALID_NP(cpa));
-	assert(BC_NUM_RDX_VALID_NP(cpb));
+	clen = bc_vm_growSize(alen, blen);
+	bc_num_expand(c, bc_vm_growSize(clen, 1));
 
-	BC_NUM_NEG_CLR_NP(cpa);
-	BC_NUM_NEG_CLR_NP(cpb);
+	ptr_c = c->num;
+	memset(ptr_c, 0, BC_NUM_SIZE(c->cap));
 
-	assert(BC_NUM_RDX_VALID_NP(cpa));
-	assert(BC_NUM_RDX_VALID_NP(cpb));
+	// This is a column-wise (Comba) product. Each column is summed whole in
+	// two BcBigDig's, so the inner loop has no branches and no divisions, and
+	// the sum is only split into a digit and a carry once per column.
+	for (i = 0; i < clen; ++i) {
 
-	ardx = BC_NUM_RDX_VAL_NP(cpa) * BC_BASE_DIGS;
-	bc_num_shiftLeft(&cpa, ardx);
+		size_t j = i < blen ? 0 : i - blen + 1, k = i - j;
+		size_t end = j + BC_MIN(alen - BC_MIN(j, alen), k + 1);
 
-	brdx = BC_NUM_RDX_VAL_NP(cpb) * BC_BASE_DIGS;
-	bc_num_shiftLeft(&cpb, brdx);
+		for (lo = carry, hi = 0; j < end; ++j, --k)
+			bc_num_colAdd(&lo, &hi, ((BcBigDig) ptr_a[j]) * ptr_b[k]);
 
-	// We need to reset the jump here because azero and bzero are used in the
-	// cleanup, and local variables are not guaranteed to be the same after a
-	// jump.
-	BC_SIG_LOCK;
+		ptr_c[i] = bc_num_colNorm(lo, hi, &carry);
+		assert(ptr_c[i] < BC_BASE_POW);
+	}
 
-	BC_UNSETJMP;
+	// This should always be true because there should be no carry on the last
+	// digit; multiplication never goes above the sum of both lengths.
+	assert(!carry);
+
+	c->len = clen;
+}
+
+static void bc_num_s_simp(const BcNum *a, BcNum *restrict c) {
+
+	size_t i, alen = a->len, clen;
+	BcDig *ptr_a = a->num, *ptr_c;
+	BcBigDig lo, hi, in = 0;
+
+	assert(sizeof(lo) >= sizeof(BcDig) * 2);
+	assert(!BC_NUM_RDX_VAL(a));
+	assert(alen < BC_NUM_KARATSUBA_LEN);
+
+	clen = bc_vm_growSize(alen, alen);
+	bc_num_expand(c, bc_vm_growSize(clen, 1));
+
+	ptr_c = c->num;
+	memset(ptr_c, 0, BC_NUM_SIZE(c->cap));
+
+	for (i = 0; i < clen; ++i) {
+
+		size_t j = i < alen ? 0 : i - alen + 1, k = i - j;
+
+		// Every cross product a[j] * a[k] with j != k shows up twice in a
+		// column, so only the ones with j < k are summed, and then the sum is
+		// doubled. That is about half of the products that m_simp would do.
+		// The column is summed whole, like in bc_num_m_simp().
+		for (lo = hi = 0; j < k; ++j, --k)
+			bc_num_colAdd(&lo, &hi, ((BcBigDig) ptr_a[j]) * ptr_a[k]);
+
+		hi += hi + (lo > BC_NUM_BIGDIG_MAX / 2);
+		lo += lo;
+
+		if (j == k) bc_num_colAdd(&lo, &hi, ((BcBigDig) ptr_a[j]) * ptr_a[j]);
+
+		bc_num_colAdd(&lo, &hi, in);
+
+		ptr_c[i] = bc_num_colNorm(lo, hi, &in);
+		assert(ptr_c[i] < BC_BASE_POW);
+	}
+
+	assert(!in);
+
+	c->len = clen;
+}
+
+#endif // BC_NUM_WIDE
+
+static void bc_num_m_high(const BcNum *a, const BcNum *b, BcNum *restrict c,
+                          size_t start)
+{
+	size_t i, alen = a->len, blen = b->len, clen;
+	BcDig *ptr_a = a->num, *ptr_b = b->num, *ptr_c;
+	BcBigDig lo, hi, carry = 0;
+
+	assert(sizeof(lo) >= sizeof(BcDig) * 2);
+	assert(!BC_NUM_RDX_VAL(a) && !BC_NUM_RDX_VAL(b));
+	assert(BC_MIN(alen, blen) < BC_BASE_POW);
+
+	clen = bc_vm_growSize(alen, blen);
+	bc_num_expand(c, bc_vm_growSize(clen, 1));
+
+	assert(start < clen);
+
+	ptr_c = c->num;
+	memset(ptr_c, 0, BC_NUM_SIZE(c->cap));
+
+	// This is the narrow bc_num_m_simp(), but it starts at column start and
+	// leaves the columns below it zero, so whatever they would have carried
+	// into it is lost. That makes the result less than the real product by
+	// less than min(alen, blen) * BC_BASE_POW^(start + 1).
+	for (i = start; i < clen; ++i) {
+
+		size_t j = i < blen ? 0 : i - blen + 1, k = i - j;
+		size_t end = j + BC_MIN(alen - BC_MIN(j, alen), k + 1);
+
+		for (lo = carry, hi = 0; j < end; ++j, --k)
+			bc_num_colAdd(&lo, &hi, ((BcBigDig) ptr_a[j]) * ptr_b[k]);
+
+		ptr_c[i] = bc_num_colNorm(lo, hi, &carry);
+		assert(ptr_c[i] < BC_BASE_POW);
+	}
+
+	assert(!carry);
+
+	c->len = clen;
+}
+
+#if BC_NUM_SIMD
+
+// The SIMD kernels below all work on vectors of digits in the same way. Adding
+// or subtracting two vectors gives every digit at once, and then the carries
+// between them come from two bit masks, one with a bit for each digit that
+// makes a carry and one for each digit that would pass an incoming carry on.
+// Adding the first mask, shifted up one, to the second is a ripple carry
+// across all of the digits, so the vector needs no loop over its digits.
+// The carry out of the vector goes into the next one.
+
+#ifdef __x86_64__
+
+// SSE2 is part of x86-64, so these need no check; the AVX2 ones do.
+#define BC_NUM_AVX2 __attribute__((target("avx2")))
+
+static inline __m128i bc_num_carrySSE2(__m128i s, unsigned int *carry) {
+
+	const __m128i max = _mm_set1_epi32(BC_BASE_POW - 1);
+	const __m128i pow = _mm_set1_epi32(BC_BASE_POW);
+	const __m128i bits = _mm_setr_epi32(1, 2, 4, 8);
+	__m128i m;
+	unsigned int g, p, c;
+
+	m = _mm_cmpgt_epi32(s, max);
+	g = (unsigned int) _mm_movemask_ps(_mm_castsi128_ps(m));
+	m = _mm_cmpeq_epi32(s, max);
+	p = (unsigned int) _mm_movemask_ps(_mm_castsi128_ps(m));
+
+	c = ((g << 1) | *carry) + p;
+	*carry = c >> 4;
+
+	m = _mm_set1_epi32((int) (c ^ p));
+	m = _mm_cmpeq_epi32(_mm_and_si128(m, bits), bits);
+	s = _mm_sub_epi32(s, m);
+	m = _mm_and_si128(_mm_cmpgt_epi32(s, max), pow);
+
+	return _mm_sub_epi32(s, m);
+}
+
+static inline __m128i bc_num_borrowSSE2(__m128i s, unsigned int *carry) {
+
+	const __m128i pow = _mm_set1_epi32(BC_BASE_POW);
+	const __m128i bits = _mm_setr_epi32(1, 2, 4, 8);
+	__m128i m;
+	unsigned int g, p, c;
+
+	g = (unsigned int) _mm_movemask_ps(_mm_castsi128_ps(s));
+	m = _mm_cmpeq_epi32(s, _mm_setzero_si128());
+	p = (unsigned int) _mm_movemask_ps(_mm_castsi128_ps(m));
+
+	c = ((g << 1) | *carry) + p;
+	*carry = c >> 4;
+
+	m = _mm_set1_epi32((int) (c ^ p));
+	m = _mm_cmpeq_epi32(_mm_and_si128(m, bits), bits);
+	s = _mm_add_epi32(s, m);
+	m = _mm_and_si128(_mm_srai_epi32(s, 31), pow);
+
+	return _mm_add_epi32(s, m);
+}
+
+static void bc_num_addArraysSSE2(BcDig *restrict a, const BcDig *restrict b,
+                                 size_t len)
+{
+	size_t i;
+	unsigned int c = 0;
+	bool carry;
+
+	for (i = 0; i + 4 <= len; i += 4) {
+		__m128i x = _mm_loadu_si128((const __m128i*) (a + i));
+		__m128i y = _mm_loadu_si128((const __m128i*) (b + i));
+		x = bc_num_carrySSE2(_mm_add_epi32(x, y), &c);
+		_mm_storeu_si128((__m128i*) (a + i), x);
+	}
+
+	carry = (c != 0);
+
+	for (; i < len; ++i) a[i] = bc_num_addDigits(a[i], b[i], &carry);
+
+	for (; carry; ++i) a[i] = bc_num_addDigits(a[i], 0, &carry);
+}
+
+static void bc_num_subArraysSSE2(BcDig *restrict a, const BcDig *restrict b,
+                                 size_t len)
+{
+	size_t i;
+	unsigned int c = 0;
+	bool carry;
+
+	for (i = 0; i + 4 <= len; i += 4) {
+		__m128i x = _mm_loadu_si128((const __m128i*) (a + i));
+		__m128i y = _mm_loadu_si128((const __m128i*) (b + i));
+		x = bc_num_borrowSSE2(_mm_sub_epi32(x, y), &c);
+		_mm_storeu_si128((__m128i*) (a + i), x);
+	}
+
+	carry = (c != 0);
+
+	for (; i < len; ++i) a[i] = bc_num_subDigits(a[i], b[i], &carry);
+
+	for (; carry; ++i) a[i] = bc_num_subDigits(a[i], 0, &carry);
+}
+
+static ssize_t bc_num_compareSSE2(const BcDig *restrict a,
+                                  const BcDig *restrict b, size_t len)
+{
+	size_t i = len;
+
+	while (i >= 4) {
+
+		__m128i eq;
+		unsigned int m;
+
+		i -= 4;
+
+		eq = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*) (a + i)),
+		                     _mm_loadu_si128((const __m128i*) (b + i)));
+		m = ~((unsigned int) _mm_movemask_ps(_mm_castsi128_ps(eq))) & 0xf;
+
+		if (m) {
+			i += 31 - (size_t) __builtin_clz(m);
+			return bc_num_neg(i + 1, a[i] < b[i]);
+		}
+	}
+
+	return bc_num_compareC(a, b, i);
+}
+
+BC_NUM_AVX2 static inline __m256i bc_num_carryAVX2(__m256i s,
+                                                   unsigned int *carry)
+{
+	const __m256i max = _mm256_set1_epi32(BC_BASE_POW - 1);
+	const __m256i pow = _mm256_set1_epi32(BC_BASE_POW);
+	const __m256i bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+	__m256i m;
+	unsigned int g, p, c;
+
+	m = _mm256_cmpgt_epi32(s, max);
+	g = (unsigned int) _mm256_movemask_ps(_mm256_castsi256_ps(m));
+	m = _mm256_cmpeq_epi32(s, max);
+	p = (unsigned int) _mm256_movemask_ps(_mm256_castsi256_ps(m));
+
+	c = ((g << 1) | *carry) + p;
+	*carry = c >> 8;
+
+	m = _mm256_set1_epi32((int) (c ^ p));
+	m = _mm256_cmpeq_epi32(_mm256_and_si256(m, bits), bits);
+	s = _mm256_sub_epi32(s, m);
+	m = _mm256_and_si256(_mm256_cmpgt_epi32(s, max), pow);
+
+	return _mm256_sub_epi32(s, m);
+}
+
+BC_NUM_AVX2 static inline __m256i bc_num_borrowAVX2(__m256i s,
+                                                    unsigned int *carry)
+{
+	const __m256i pow = _mm256_set1_epi32(BC_BASE_POW);
+	const __m256i bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+	__m256i m;
+	unsigned int g, p, c;
+
+	g = (unsigned int) _mm256_movemask_ps(_mm256_castsi256_ps(s));
+	m = _mm256_cmpeq_epi32(s, _mm256_setzero_si256());
+	p = (unsigned int) _mm256_movemask_ps(_mm256_castsi256_ps(m));
+
+	c = ((g << 1) | *carry) + p;
+	*carry = c >> 8;
+
+	m = _mm256_set1_epi32((int) (c ^ p));
+	m = _mm256_cmpeq_epi32(_mm256_and_si256(m, bits), bits);
+	s = _mm256_add_epi32(s, m);
+	m = _mm256_and_si256(_mm256_srai_epi32(s, 31), pow);
+
+	return _mm256_add_epi32(s, m);
+}
+
+BC_NUM_AVX2 static void bc_num_addArraysAVX2(BcDig *restrict a,
+                                             const BcDig *restrict b,
+                                             size_t len)
+{
+	size_t i;
+	unsigned int c = 0;
+	bool carry;
+
+	for (i = 0; i + 8 <= len; i += 8) {
+		__m256i x = _mm256_loadu_si256((const __m256i*) (a + i));
+		__m256i y = _mm256_loadu_si256((const __m256i*) (b + i));
+		x = bc_num_carryAVX2(_mm256_add_epi32(x, y), &c);
+		_mm256_storeu_si256((__m256i*) (a + i), x);
+	}
+
+	carry = (c != 0);
+
+	for (; i < len; ++i) a[i] = bc_num_addDigits(a[i], b[i], &carry);
+
+	for (; carry; ++i) a[i] = bc_num_addDigits(a[i], 0, &carry);
+}
+
+BC_NUM_AVX2 static void bc_num_subArraysAVX2(BcDig *restrict a,
+                                             const BcDig *restrict b,
+                                             size_t len)
+{
+	size_t i;
+	unsigned int c = 0;
+	bool carry;
+
+	for (i = 0; i + 8 <= len; i += 8) {
+		__m256i x = _mm256_loadu_si256((const __m256i*) (a + i));
+		__m256i y = _mm256_loadu_si256((const __m256i*) (b + i));
+		x = bc_num_borrowAVX2(_mm256_sub_epi32(x, y), &c);
+		_mm256_storeu_si256((__m256i*) (a + i), x);
+	}
+
+	carry = (c != 0);
+
+	for (; i < len; ++i) a[i] = bc_num_subDigits(a[i], b[i], &carry);
+
+	for (; carry; ++i) a[i] = bc_num_subDigits(a[i], 0, &carry);
+}
+
+BC_NUM_AVX2 static BcBigDig bc_num_mulDigitsAVX2(BcDig *restrict c,
+                                                 const BcDig *restrict a,
+                                                 size_t len, BcBigDig b)
+{
+	const __m256i max = _mm256_set1_epi32(BC_BASE_POW - 1);
+	const __m256i pow = _mm256_set1_epi32(BC_BASE_POW);
+	const __m256i bv = _mm256_set1_epi32((int) b);
+	const __m256i up = _mm256_setr_epi32(7, 0, 1, 2, 3, 4, 5, 6);
+	const __m256d f = _mm256_set1_pd(((double) b) / BC_BASE_POW);
+	size_t i;
+	BcBigDig hi = 0;
+	unsigned int cy = 0;
+	bool carry;
+
+	for (i = 0; i + 8 <= len; i += 8) {
+
+		__m256i av, q, r, m;
+		__m128i lo;
+
+		av = _mm256_loadu_si256((const __m256i*) (a + i));
+
+		// The quotients by BC_BASE_POW come from doubles, and they can be off
+		// by one, which the remainders show and fix.
+		lo = _mm256_castsi256_si128(av);
+		lo = _mm256_cvttpd_epi32(_mm256_mul_pd(_mm256_cvtepi32_pd(lo), f));
+		q = _mm256_castsi128_si256(lo);
+		lo = _mm256_extracti128_si256(av, 1);
+		lo = _mm256_cvttpd_epi32(_mm256_mul_pd(_mm256_cvtepi32_pd(lo), f));
+		q = _mm256_inserti128_si256(q, lo, 1);
+		r = _mm256_sub_epi32(_mm256_mullo_epi32(av, bv),
+		                     _mm256_mullo_epi32(q, pow));
+
+		m = _mm256_srai_epi32(r, 31);
+		q = _mm256_add_epi32(q, m);
+		r = _mm256_add_epi32(r, _mm256_and_si256(m, pow));
+		m = _mm256_cmpgt_epi32(r, max);
+		q = _mm256_sub_epi32(q, m);
+		r = _mm256_sub_epi32(r, _mm256_and_si256(m, pow));
+
+		m = _mm256_permutevar8x32_epi32(q, up);
+		q = _mm256_set1_epi32((int) hi);
+		hi = (BcBigDig) _mm_cvtsi128_si32(_mm256_castsi256_si128(m));
+		m = _mm256_blend_epi32(m, q, 1);
+
+		r = bc_num_carryAVX2(_mm256_add_epi32(r, m), &cy);
+		_mm256_storeu_si256((__m256i*) (c + i), r);
+	}
+
+	carry = (cy != 0);
+
+	for (; i < len; ++i) {
+		BcBigDig in = ((BcBigDig) a[i]) * b;
+		c[i] = bc_num_addDigits((BcDig) (in % BC_BASE_POW), (BcDig) hi,
+		                        &carry);
+		hi = in / BC_BASE_POW;
+	}
+
+	return hi + carry;
+}
+
+BC_NUM_AVX2 static ssize_t bc_num_compareAVX2(const BcDig *restrict a,
+                                              const BcDig *restrict b,
+                                              size_t len)
+{
+	size_t i = len;
+
+	while (i >= 8) {
+
+		__m256i eq;
+		unsigned int m;
+
+		i -= 8;
+
+		eq = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i*) (a + i)),
+		                        _mm256_loadu_si256((const __m256i*) (b + i)));
+		m = ~((unsigned int) _mm256_movemask_ps(_mm256_castsi256_ps(eq)));
+		m &= 0xff;
+
+		if (m) {
+			i += 31 - (size_t) __builtin_clz(m);
+			return bc_num_neg(i + 1, a[i] < b[i]);
+		}
+	}
+
+	return bc_num_compareC(a, b, i);
+}
+
+#else // __x86_64__
+
+static inline unsigned int bc_num_maskNEON(uint32x4_t m) {
+	static const uint32_t bits[] = { 1, 2, 4, 8 };
+	return vaddvq_u32(vandq_u32(m, vld1q_u32(bits)));
+}
+
+static inline int32x4_t bc_num_lanesNEON(unsigned int m) {
+	static const uint32_t bits[] = { 1, 2, 4, 8 };
+	return vreinterpretq_s32_u32(vtstq_u32(vdupq_n_u32(m), vld1q_u32(bits)));
+}
+
+static inline int32x4_t bc_num_carryNEON(int32x4_t s, unsigned int *carry) {
+
+	const int32x4_t max = vdupq_n_s32(BC_BASE_POW - 1);
+	int32x4_t m;
+	unsigned int g, p, c;
+
+	g = bc_num_maskNEON(vcgtq_s32(s, max));
+	p = bc_num_maskNEON(vceqq_s32(s, max));
+
+	c = ((g << 1) | *carry) + p;
+	*carry = c >> 4;
+
+	s = vsubq_s32(s, bc_num_lanesNEON(c ^ p));
+	m = vreinterpretq_s32_u32(vcgtq_s32(s, max));
+
+	return vsubq_s32(s, vandq_s32(m, vdupq_n_s32(BC_BASE_POW)));
+}
+
+static inline int32x4_t bc_num_borrowNEON(int32x4_t s, unsigned int *carry) {
+
+	int32x4_t m;
+	unsigned int g, p, c;
+
+	g = bc_num_maskNEON(vcltzq_s32(s));
+	p = bc_num_maskNEON(vceqzq_s32(s));
+
+	c = ((g << 1) | *carry) + p;
+	*carry = c >> 4;
+
+	s = vaddq_s32(s, bc_num_lanesNEON(c ^ p));
+	m = vshrq_n_s32(s, 31);
+
+	return vaddq_s32(s, vandq_s32(m, vdupq_n_s32(BC_BASE_POW)));
+}
+
+static void bc_num_addArraysNEON(BcDig *restrict a, const BcDig *restrict b,
+                                 size_t len)
+{
+	size_t i;
+	unsigned int c = 0;
+	bool carry;
+
+	for (i = 0; i + 4 <= len; i += 4) {
+		int32x4_t s = vaddq_s32(vld1q_s32(a + i), vld1q_s32(b + i));
+		vst1q_s32(a + i, bc_num_carryNEON(s, &c));
+	}
+
+	carry = (c != 0);
+
+	for (; i < len; ++i) a[i] = bc_num_addDigits(a[i], b[i], &carry);
+
+	for (; carry; ++i) a[i] = bc_num_addDigits(a[i], 0, &carry);
+}
+
+static void bc_num_subArraysNEON(BcDig *restrict a, const BcDig *restrict b,
+                                 size_t len)
+{
+	size_t i;
+	unsigned int c = 0;
+	bool carry;
+
+	for (i = 0; i + 4 <= len; i += 4) {
+		int32x4_t s = vsubq_s32(vld1q_s32(a + i), vld1q_s32(b + i));
+		vst1q_s32(a + i, bc_num_borrowNEON(s, &c));
+	}
+
+	carry = (c != 0);
+
+	for (; i < len; ++i) a[i] = bc_num_subDigits(a[i], b[i], &carry);
+
+	for (; carry; ++i) a[i] = bc_num_subDigits(a[i], 0, &carry);
+}
+
+static BcBigDig bc_num_mulDigitsNEON(BcDig *restrict c,
+                                     const BcDig *restrict a, size_t len,
+                                     BcBigDig b)
+{
+	const int32x4_t max = vdupq_n_s32(BC_BASE_POW - 1);
+	const int32x4_t pow = vdupq_n_s32(BC_BASE_POW);
+	const int32x4_t bv = vdupq_n_s32((int32_t) b);
+	const float64x2_t f = vdupq_n_f64(((double) b) / BC_BASE_POW);
+	int32x4_t q = vdupq_n_s32(0);
+	size_t i;
+	BcBigDig hi;
+	unsigned int cy = 0;
+	bool carry;
+
+	for (i = 0; i + 4 <= len; i += 4) {
+
+		int32x4_t av, r, m, prev = q;
+		float64x2_t d;
+		int32x2_t lo;
+
+		av = vld1q_s32(a + i);
+
+		// See bc_num_mulDigitsAVX2().
+		d = vcvtq_f64_s64(vmovl_s32(vget_low_s32(av)));
+		lo = vmovn_s64(vcvtq_s64_f64(vmulq_f64(d, f)));
+		d = vcvtq_f64_s64(vmovl_s32(vget_high_s32(av)));
+		q = vcombine_s32(lo, vmovn_s64(vcvtq_s64_f64(vmulq_f64(d, f))));
+		r = vsubq_s32(vmulq_s32(av, bv), vmulq_s32(q, pow));
+
+		m = vshrq_n_s32(r, 31);
+		q = vaddq_s32(q, m);
+		r = vaddq_s32(r, vandq_s32(m, pow));
+		m = vreinterpretq_s32_u32(vcgtq_s32(r, max));
+		q = vsubq_s32(q, m);
+		r = vsubq_s32(r, vandq_s32(m, pow));
+
+		r = vaddq_s32(r, vextq_s32(prev, q, 3));
+		vst1q_s32(c + i, bc_num_carryNEON(r, &cy));
+	}
+
+	hi = (BcBigDig) vgetq_lane_s32(q, 3);
+	carry = (cy != 0);
+
+	for (; i < len; ++i) {
+		BcBigDig in = ((BcBigDig) a[i]) * b;
+		c[i] = bc_num_addDigits((BcDig) (in % BC_BASE_POW), (BcDig) hi,
+		                        &carry);
+		hi = in / BC_BASE_POW;
+	}
+
+	return hi + carry;
+}
+
+static ssize_t bc_num_compareNEON(const BcDig *restrict a,
+                                  const BcDig *restrict b, size_t len)
+{
+	size_t i = len;
+
+	while (i >= 4) {
+
+		unsigned int m;
+
+		i -= 4;
+
+		m = bc_num_maskNEON(vceqq_s32(vld1q_s32(a + i), vld1q_s32(b + i)));
+		m = ~m & 0xf;
+
+		if (m) {
+			i += 31 - (size_t) __builtin_clz(m);
+			return bc_num_neg(i + 1, a[i] < b[i]);
+		}
+	}
+
+	return bc_num_compareC(a, b, i);
+}
+
+#endif // __x86_64__
+
+void bc_num_simdInit(void) {
+
+#ifdef __x86_64__
+
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx2")) {
+		bc_num_addArrays = bc_num_addArraysAVX2;
+		bc_num_subArrays = bc_num_subArraysAVX2;
+		bc_num_mulDigits = bc_num_mulDigitsAVX2;
+		bc_num_compare = bc_num_compareAVX2;
+	}
+	else {
+
+		// SSE2 has no 32-bit multiply to build the multiplication kernels on,
+		// and without one, they were no faster than the portable ones.
+		bc_num_addArrays = bc_num_addArraysSSE2;
+		bc_num_subArrays = bc_num_subArraysSSE2;
+		bc_num_compare = bc_num_compareSSE2;
+	}
+
+#else // __x86_64__
+
+	bc_num_addArrays = bc_num_addArraysNEON;
+	bc_num_subArrays = bc_num_subArraysNEON;
+	bc_num_mulDigits = bc_num_mulDigitsNEON;
+	bc_num_compare = bc_num_compareNEON;
+
+#endif // __x86_64__
+}
+
+#endif // BC_NUM_SIMD
+
+static void bc_num_shiftAddSub(BcNum *restrict n, const BcNum *restrict a,
+                               size_t shift, BcNumShiftAddOp op)
+{
+	assert(n->len >= shift + a->len);
+	assert(!BC_NUM_RDX_VAL(n) && !BC_NUM_RDX_VAL(a));
+	op(n->num + shift, a->num, a->len);
+}
+
+static void bc_num_slice(const BcNum *restrict n, size_t idx, size_t len,
+                         BcNum *restrict v)
+{
+	// This sets up v as a read-only view of len digits of n, starting at idx.
+	// No memory is allocated, so v must not be freed or written to.
+	if (idx < n->len) {
+		len = BC_MIN(len, n->len - idx);
+		bc_num_setup(v, n->num + idx, len);
+		v->len = len;
+		bc_num_clean(v);
+	}
+	else bc_num_setup(v, n->num, 0);
+}
+
+static BcDig* bc_num_carve(BcNum *restrict n, BcDig *restrict scratch,
+                           size_t cap)
+{
+	// This sets up n with the next cap digits of a scratch arena and returns
+	// the rest of the arena. Like a slice, n must not be freed or expanded.
+	bc_num_setup(n, scratch, cap);
+	return scratch + cap;
+}
+
+static void bc_num_divExact(const BcNum *restrict a, BcBigDig d,
+                            BcNum *restrict c)
+{
+	BcBigDig rem;
+	bool neg = BC_NUM_NEG(a);
+
+	assert(!BC_NUM_RDX_VAL(a));
+
+	bc_num_expand(c, a->len);
+	c->scale = 0;
+	c->rdx = 0;
+
+	bc_num_divArray(a, d, c, &rem);
+
+	assert(!rem);
+
+	if (BC_NUM_NONZERO(c)) c->rdx = BC_NUM_NEG_VAL(c, neg);
+}
+
+static uint32_t bc_num_nttPow(uint32_t b, uint64_t e, uint32_t p) {
+
+	uint64_t r = 1, x = b;
+
+	for (; e; e >>= 1) {
+		if (e & 1) r = r * x % p;
+		x = x * x % p;
+	}
+
+	return (uint32_t) r;
+}
+
+static inline uint32_t bc_num_nttRedc(uint64_t t, uint32_t p, uint32_t pinv) {
+
+	// Montgomery reduction with R = 2^32. This requires t < p * 2^32 and
+	// returns t / R mod p, using pinv == -p^-1 mod R.
+	uint32_t m = ((uint32_t) t) * pinv;
+	uint64_t u = (t + ((uint64_t) m) * p) >> 32;
+
+	return (uint32_t) (u >= p ? u - p : u);
+}
+
+static void bc_num_nttTransform(uint32_t *restrict a, size_t n,
+                                const uint32_t *restrict roots,
+                                uint32_t p, uint32_t pinv)
+{
+	size_t i, j, k, len, half, step;
+
+	for (i = 1, j = 0; i < n; ++i) {
+
+		size_t bit = n >> 1;
+
+		for (; j & bit; bit >>= 1) j ^= bit;
+		j ^= bit;
+
+		if (i < j) {
+			uint32_t temp = a[i];
+			a[i] = a[j];
+			a[j] = temp;
+		}
+	}
+
+	for (len = 2; len <= n; len <<= 1) {
+
+		half = len >> 1;
+		step = n / len;
+
+		for (i = 0; i < n; i += len) {
+
+			uint32_t *lo = a + i, *hi = a + i + half;
+
+			for (j = 0, k = 0; j < half; ++j, k += step) {
+
+				uint32_t u = lo[j];
+				uint32_t v = bc_num_nttRedc(((uint64_t) hi[j]) * roots[k],
+				                            p, pinv);
+
+				lo[j] = u + v >= p ? u + v - p : u + v;
+				hi[j] = u >= v ? u - v : u + p - v;
+			}
+		}
+	}
+}
+
+static void bc_num_nttLoad(uint32_t *restrict f, size_t n,
+                           const BcNum *restrict a, uint32_t p)
+{
+	size_t i;
+
+	// Limbs can be several times the smaller primes, so they need a full
+	// reduction. Every residue is then less than p, and the transforms keep it
+	// that way, so the products in bc_num_nttRedc() are less than p * 2^32.
+	for (i = 0; i < a->len; ++i) f[i] = ((uint32_t) a->num[i]) % p;
+
+	memset(f + a->len, 0, (n - a->len) * sizeof(uint32_t));
+}
+
+static void bc_num_ntt(BcNum *a, BcNum *b, BcNum *restrict c) {
+
+	static const uint32_t primes[] = {
+		BC_NUM_NTT_P1, BC_NUM_NTT_P2, BC_NUM_NTT_P3
+	};
+
+	size_t i, j, n, clen;
+	uint32_t *mem, *fb, *roots, *res[3];
+	uint64_t acc0, acc1, acc2;
+	bool sqr = (a == b);
+
+	assert(BC_NUM_ZERO(c));
+	assert(!BC_NUM_RDX_VAL(a) && !BC_NUM_RDX_VAL(b));
+
+	// This multiplies with a number-theoretic transform: the digit arrays are
+	// convolved modulo three primes (each convolution is two forward
+	// transforms, a pointwise product, and an inverse transform) and the exact
+	// convolution is then put back together with the Chinese Remainder Theorem
+	// while carrying into BC_BASE_POW. That is O(n*log(n)).
+
+	clen = bc_vm_growSize(a->len, b->len);
+	for (n = 1; n < clen - 1; n <<= 1);
+
+	assert(n <= (((size_t) 1) << BC_NUM_NTT_MAX_LOG));
+
+	BC_SIG_LOCK;
+
+	mem = bc_vm_malloc(bc_vm_arraySize(bc_vm_growSize(4 * n, n / 2),
+	                                   sizeof(uint32_t)));
+
+	BC_SETJMP_LOCKED(err);
+
+	BC_SIG_UNLOCK;
+
+	fb = mem;
+	roots = fb + n;
+	res[0] = roots + n / 2;
+	res[1] = res[0] + n;
+	res[2] = res[1] + n;
+
+	for (i = 0; i < sizeof(primes) / sizeof(uint32_t); ++i) {
+
+		uint32_t p = primes[i], pinv = p, r, w, f, *fa = res[i];
+		uint64_t wk;
+
+		// Newton's iteration for the inverse mod 2^32; each step doubles the
+		// number of correct bits, and p is its own inverse mod 2^3.
+		for (j = 0; j < 4; ++j) pinv *= 2 - p * pinv;
+		pinv = 0 - pinv;
+
+		r = (uint32_t) ((((uint64_t) 1) << 32) % p);
+		w = bc_num_nttPow(BC_NUM_NTT_ROOT, (p - 1) / n, p);
+
+		// The roots are kept in Montgomery form so that reducing a product
+		// with one of them gives a plain residue back.
+		for (j = 0, wk = 1; j < n / 2; ++j, wk = wk * w % p)
+			roots[j] = (uint32_t) (wk * r % p);
+
+		// This factor is R^2 / n, which undoes both the R^-1 from the pointwise
+		// reduction and the n from the inverse transform.
+		f = (uint32_t) (((uint64_t) r) * r % p *
+		                bc_num_nttPow((uint32_t) (n % p), p - 2, p) % p);
+
+		bc_num_nttLoad(fa, n, a, p);
+		bc_num_nttTransform(fa, n, roots, p, pinv);
+
+		// A square only needs the one transform.
+		if (sqr) fb = fa;
+		else {
+			bc_num_nttLoad(fb, n, b, p);
+			bc_num_nttTransform(fb, n, roots, p, pinv);
+		}
+
+		for (j = 0; j < n; ++j) {
+			uint32_t v = bc_num_nttRedc(((uint64_t) fa[j]) * fb[j], p, pinv);
+			fa[j] = bc_num_nttRedc(((uint64_t) v) * f, p, pinv);
+		}
+
+		// The inverse transform is the forward one with the outputs reversed.
+		bc_num_nttTransform(fa, n, roots, p, pinv);
+
+		for (j = 1; j < n - j; ++j) {
+			uint32_t temp = fa[j];
+			fa[j] = fa[n - j];
+			fa[n - j] = temp;
+		}
+	}
+
+	bc_num_expand(c, clen);
+
+	// The accumulator is three 32-bit words (in 64-bit variables so that the
+	// carries between them have room) because each term can be as big as the
+	// product of the primes, which is about 2^86.
+	for (i = 0, acc0 = acc1 = acc2 = 0; i < clen; ++i) {
+
+		if (i < clen - 1) {
+
+			uint64_t r1 = res[0][i], r2 = res[1][i], r3 = res[2][i];
+			uint64_t t2, t3, y, lo, hi;
+
+			// Garner's algorithm: x = r1 + p1 * (t2 + p2 * t3).
+			t2 = (r2 + BC_NUM_NTT_P2 - r1 % BC_NUM_NTT_P2) % BC_NUM_NTT_P2;
+			t2 = t2 * BC_NUM_NTT_P1_INV_P2 % BC_NUM_NTT_P2;
+			t3 = (r3 + BC_NUM_NTT_P3 - r1 % BC_NUM_NTT_P3) % BC_NUM_NTT_P3;
+			t3 = t3 * BC_NUM_NTT_P1_INV_P3 % BC_NUM_NTT_P3;
+			t3 = (t3 + BC_NUM_NTT_P3 - t2 % BC_NUM_NTT_P3) % BC_NUM_NTT_P3;
+			t3 = t3 * BC_NUM_NTT_P2_INV_P3 % BC_NUM_NTT_P3;
+			y = t2 + t3 * BC_NUM_NTT_P2;
+
+			lo = (y & UINT32_MAX) * BC_NUM_NTT_P1 + r1;
+			hi = (y >> 32) * BC_NUM_NTT_P1 + (lo >> 32);
+
+			acc0 += lo & UINT32_MAX;
+			acc1 += (hi & UINT32_MAX) + (acc0 >> 32);
+			acc2 += (hi >> 32) + (acc1 >> 32);
+			acc0 &= UINT32_MAX;
+			acc1 &= UINT32_MAX;
+		}
+
+		// Divide the accumulator by BC_BASE_POW; the remainder is the digit.
+		acc1 |= (acc2 % BC_BASE_POW) << 32;
+		acc2 /= BC_BASE_POW;
+		acc0 |= (acc1 % BC_BASE_POW) << 32;
+		acc1 /= BC_BASE_POW;
+		c->num[i] = (BcDig) (acc0 % BC_BASE_POW);
+		acc0 /= BC_BASE_POW;
+	}
+
+	assert(!acc0 && !acc1 && !acc2);
+
+	c->len = clen;
+	bc_num_clean(c);
+
+err:
+	BC_SIG_MAYLOCK;
+	free(mem);
+	BC_LONGJMP_CONT;
+}
+
+static inline bool bc_num_nttOk(size_t alen, size_t blen) {
+	// If the product is too big for the transform, Toom-3 and Karatsuba will
+	// split it until the pieces fit.
+	return alen >= BC_NUM_NTT_LEN && blen >= BC_NUM_NTT_LEN &&
+	       alen + blen - 1 <= (((size_t) 1) << BC_NUM_NTT_MAX_LOG);
+}
+
+static size_t bc_num_kScratch(size_t n) {
+
+	size_t m, k, karat, toom;
+
+	if (n < BC_NUM_KARATSUBA_LEN) return 0;
+
+	// This mirrors what bc_num_kara() and bc_num_toom3() carve out for
+	// themselves, plus what their children need, which reuse the same space
+	// one after another. Which one is used depends on the lengths of the
+	// pieces after cleaning, so this takes the bigger of the two; both are
+	// linear in n. bc_num_unbal() only runs when the short operand has no
+	// more than half of n, so it always needs less than bc_num_kara().
+	m = (n + 1) / 2;
+	karat = 2 * (m + 1) + 3 * BC_NUM_KREQ(m) + bc_num_kScratch(m);
+
+	if (n < BC_NUM_TOOM3_LEN) return karat;
+
+	k = (n + 2) / 3;
+	toom = 6 * (k + 2) + 7 * BC_NUM_KREQ(k + 1) + bc_num_kScratch(k + 1);
+
+	return BC_MAX(karat, toom);
+}
+
+static void bc_num_toom3(BcNum *a, BcNum *b, BcNum *restrict c,
+                         BcDig *restrict scratch)
+{
+	size_t max, k, req, clen;
+	BcNum a0, a1, a2, b0, b1, b2, pa1, pam1, pam2, pb1, pbm1, pbm2;
+	BcNum r0, r1, rm1, rm2, rinf, t1, t2;
+	BcNum *ptr_b0, *ptr_b1, *ptr_bm1, *ptr_bm2, *ptr_binf;
+	bool sqr = (a == b), neg1, neg2;
+
+	assert(BC_NUM_ZERO(c));
+	assert(!BC_NUM_RDX_VAL(a) && !BC_NUM_RDX_VAL(b));
+
+	// This is the Toom-3 (Toom-Cook 3-way) algorithm. Both operands are split
+	// into three pieces of k digits, which makes them polynomials in x = 10^k
+	// (in BcDig terms). Those polynomials are evaluated at the points 0, 1, -1,
+	// -2, and infinity, the five evaluations are multiplied pairwise (which
+	// recurses back into the Karatsuba/Toom-3 dispatch), and the product
+	// polynomial is recovered with Marco Bodrato's interpolation sequence. That
+	// means five multiplications of a third of the size instead of the nine
+	// that brute force would need, or O(n^log_3(5)).
+
+	max = BC_MAX(a->len, b->len);
+	k = (max + 2) / 3;
+	clen = bc_vm_growSize(a->len, b->len);
+
+	bc_num_slice(a, 0, k, &a0);
+	bc_num_slice(a, k, k, &a1);
+	bc_num_slice(a, 2 * k, k, &a2);
+
+	if (!sqr) {
+		bc_num_slice(b, 0, k, &b0);
+		bc_num_slice(b, k, k, &b1);
+		bc_num_slice(b, 2 * k, k, &b2);
+	}
+
+	// The evaluations are less than 7 * 10^k, so they fit in k + 1 digits, plus
+	// one for bc_num_add() and bc_num_sub(). The layout has to match what
+	// bc_num_kScratch() expects.
+	req = k + 2;
+
+	scratch = bc_num_carve(&pa1, scratch, req);
+	scratch = bc_num_carve(&pam1, scratch, req);
+	scratch = bc_num_carve(&pam2, scratch, req);
+	scratch = bc_num_carve(&pb1, scratch, req);
+	scratch = bc_num_carve(&pbm1, scratch, req);
+	scratch = bc_num_carve(&pbm2, scratch, req);
+
+	req = BC_NUM_KREQ(k + 1);
+
+	scratch = bc_num_carve(&r0, scratch, req);
+	scratch = bc_num_carve(&r1, scratch, req);
+	scratch = bc_num_carve(&rm1, scratch, req);
+	scratch = bc_num_carve(&rm2, scratch, req);
+	scratch = bc_num_carve(&rinf, scratch, req);
+	scratch = bc_num_carve(&t1, scratch, req);
+	scratch = bc_num_carve(&t2, scratch, req);
+
+	// Evaluation. p(1) = a0 + a1 + a2, p(-1) = a0 - a1 + a2, and
+	// p(-2) = 2 * (p(-1) + a2) - a0.
+	bc_num_add(&a0, &a2, &t1, 0);
+	bc_num_add(&t1, &a1, &pa1, 0);
+	bc_num_sub(&t1, &a1, &pam1, 0);
+	bc_num_add(&pam1, &a2, &t1, 0);
+	bc_num_add(&t1, &t1, &t2, 0);
+	bc_num_sub(&t2, &a0, &pam2, 0);
+
+	// When squaring, the second polynomial is the first one, so its
+	// evaluations are reused, and the pointwise products become squares.
+	if (sqr) {
+		ptr_b0 = &a0;
+		ptr_b1 = &pa1;
+		ptr_bm1 = &pam1;
+		ptr_bm2 = &pam2;
+		ptr_binf = &a2;
+	}
+	else {
+
+		bc_num_add(&b0, &b2, &t1, 0);
+		bc_num_add(&t1, &b1, &pb1, 0);
+		bc_num_sub(&t1, &b1, &pbm1, 0);
+		bc_num_add(&pbm1, &b2, &t1, 0);
+		bc_num_add(&t1, &t1, &t2, 0);
+		bc_num_sub(&t2, &b0, &pbm2, 0);
+
+		ptr_b0 = &b0;
+		ptr_b1 = &pb1;
+		ptr_bm1 = &pbm1;
+		ptr_bm2 = &pbm2;
+		ptr_binf = &b2;
+	}
+
+	// Pointwise multiplication. bc_num_k() only multiplies magnitudes, so the
+	// signs of the two negative points are put back by hand.
+	bc_num_k(&a0, ptr_b0, &r0, scratch);
+	bc_num_k(&pa1, ptr_b1, &r1, scratch);
+
+	neg1 = BC_NUM_NEG_NP(pam1);
+	neg2 = BC_NUM_NEG(ptr_bm1);
+	BC_NUM_NEG_CLR_NP(pam1);
+	BC_NUM_NEG_CLR(ptr_bm1);
+	bc_num_k(&pam1, ptr_bm1, &rm1, scratch);
+	if (BC_NUM_NONZERO(&rm1)) rm1.rdx = BC_NUM_NEG_VAL_NP(rm1, neg1 != neg2);
+
+	neg1 = BC_NUM_NEG_NP(pam2);
+	neg2 = BC_NUM_NEG(ptr_bm2);
+	BC_NUM_NEG_CLR_NP(pam2);
+	BC_NUM_NEG_CLR(ptr_bm2);
+	bc_num_k(&pam2, ptr_bm2, &rm2, scratch);
+	if (BC_NUM_NONZERO(&rm2)) rm2.rdx = BC_NUM_NEG_VAL_NP(rm2, neg1 != neg2);
+
+	bc_num_k(&a2, ptr_binf, &rinf, scratch);
+
+	// Interpolation. All of the divisions are exact. When this is done, r0,
+	// r1, rm1 (the x^2 coefficient), rm2 (the x^3 coefficient), and rinf hold
+	// the coefficients of the product, and all of them are non-negative.
+	bc_num_sub(&rm2, &r1, &t1, 0);
+	bc_num_divExact(&t1, 3, &rm2);
+	bc_num_sub(&r1, &rm1, &t1, 0);
+	bc_num_divExact(&t1, 2, &r1);
+	bc_num_sub(&rm1, &r0, &t1, 0);
+	bc_num_copy(&rm1, &t1);
+	bc_num_sub(&rm1, &rm2, &t1, 0);
+	bc_num_divExact(&t1, 2, &t2);
+	bc_num_add(&rinf, &rinf, &t1, 0);
+	bc_num_add(&t2, &t1, &rm2, 0);
+	bc_num_add(&rm1, &r1, &t1, 0);
+	bc_num_sub(&t1, &rinf, &rm1, 0);
+	bc_num_sub(&r1, &rm2, &t1, 0);
+	bc_num_copy(&r1, &t1);
+
+	assert(!BC_NUM_NEG_NP(r0) && !BC_NUM_NEG_NP(r1) && !BC_NUM_NEG_NP(rm1));
+	assert(!BC_NUM_NEG_NP(rm2) && !BC_NUM_NEG_NP(rinf));
+
+	// Recomposition. Because every coefficient is non-negative and the sum is
+	// the product, nothing can carry past clen.
+	assert(c->cap >= clen);
+	c->len = clen;
+	memset(c->num, 0, BC_NUM_SIZE(c->len));
+
+	bc_num_shiftAddSub(c, &r0, 0, bc_num_addArrays);
+	bc_num_shiftAddSub(c, &r1, k, bc_num_addArrays);
+	bc_num_shiftAddSub(c, &rm1, 2 * k, bc_num_addArrays);
+	bc_num_shiftAddSub(c, &rm2, 3 * k, bc_num_addArrays);
+	bc_num_shiftAddSub(c, &rinf, 4 * k, bc_num_addArrays);
+
+	bc_num_clean(c);
+}
+
+static void bc_num_kara(BcNum *a, BcNum *b, BcNum *restrict c,
+                        BcDig *restrict scratch)
+{
+	size_t max, max2, req;
+	BcNum l1, h1, l2, h2, m2, m1, z0, z1, z2;
+	BcNum *ptr_l2, *ptr_h2, *ptr_m2;
+	BcNumShiftAddOp op;
+	bool sqr = (a == b), neg1, neg2;
+
+	assert(BC_NUM_ZERO(c));
+	assert(!BC_NUM_RDX_VAL(a) && !BC_NUM_RDX_VAL(b));
+
+	max = BC_MAX(a->len, b->len);
+	max2 = (max + 1) / 2;
+
+	bc_num_slice(a, 0, max2, &l1);
+	bc_num_slice(a, max2, max2, &h1);
+
+	// The halves and their difference have no more than max2 digits, plus one
+	// for bc_num_sub(). The layout has to match what bc_num_kScratch() expects.
+	req = max2 + 1;
+
+	scratch = bc_num_carve(&m1, scratch, req);
+	scratch = bc_num_carve(&m2, scratch, req);
+
+	req = BC_NUM_KREQ(max2);
+
+	scratch = bc_num_carve(&z0, scratch, req);
+	scratch = bc_num_carve(&z1, scratch, req);
+	scratch = bc_num_carve(&z2, scratch, req);
+
+	// This gives room for carries before the middle term is subtracted.
+	assert(c->cap >= BC_NUM_KREQ(max));
+	c->len = BC_NUM_KREQ(max) - 1;
+	memset(c->num, 0, BC_NUM_SIZE(c->len));
+
+	bc_num_sub(&h1, &l1, &m1, 0);
+
+	// When squaring, all three products are squares of a half, which recurse
+	// back here as squares. The middle one is (h - l)^2, which has to be
+	// subtracted instead of (h - l)(l - h) being added.
+	if (sqr) {
+		ptr_l2 = &l1;
+		ptr_h2 = &h1;
+		ptr_m2 = &m1;
+	}
+	else {
+
+		bc_num_slice(b, 0, max2, &l2);
+		bc_num_slice(b, max2, max2, &h2);
+		bc_num_sub(&l2, &h2, &m2, 0);
+
+		ptr_l2 = &l2;
+		ptr_h2 = &h2;
+		ptr_m2 = &m2;
+	}
+
+	if (BC_NUM_NONZERO(&h1) && BC_NUM_NONZERO(ptr_h2)) {
+
+		bc_num_k(&h1, ptr_h2, &z2, scratch);
+
+		bc_num_shiftAddSub(c, &z2, max2 * 2, bc_num_addArrays);
+		bc_num_shiftAddSub(c, &z2, max2, bc_num_addArrays);
+	}
+
+	if (BC_NUM_NONZERO(&l1) && BC_NUM_NONZERO(ptr_l2)) {
+
+		bc_num_k(&l1, ptr_l2, &z0, scratch);
+
+		bc_num_shiftAddSub(c, &z0, max2, bc_num_addArrays);
+		bc_num_shiftAddSub(c, &z0, 0, bc_num_addArrays);
+	}
+
+	if (BC_NUM_NONZERO(&m1) && BC_NUM_NONZERO(ptr_m2)) {
+
+		neg1 = BC_NUM_NEG_NP(m1);
+		neg2 = BC_NUM_NEG(ptr_m2);
+		BC_NUM_NEG_CLR_NP(m1);
+		BC_NUM_NEG_CLR(ptr_m2);
+
+		bc_num_k(&m1, ptr_m2, &z1, scratch);
+
+		op = (sqr || neg1 != neg2) ? bc_num_subArrays : bc_num_addArrays;
+		bc_num_shiftAddSub(c, &z1, max2, op);
+	}
+
+	bc_num_clean(c);
+}
+
+static void bc_num_unbal(BcNum *a, BcNum *b, BcNum *restrict c,
+                         BcDig *restrict scratch)
+{
+	size_t i, clen;
+	BcNum *lng, *shrt, chunk, t;
+
+	assert(BC_NUM_ZERO(c));
+	assert(!BC_NUM_RDX_VAL(a) && !BC_NUM_RDX_VAL(b));
+
+	if (a->len >= b->len) {
+		lng = a;
+		shrt = b;
+	}
+	else {
+		lng = b;
+		shrt = a;
+	}
+
+	// When the operands are very different in size, Karatsuba would split both
+	// of them at half of the long one, which leaves the short one whole and
+	// wastes most of the work. Instead, this cuts the long operand into chunks
+	// the size of the short one, multiplies each chunk with the short one as a
+	// balanced product, and adds each product in at its offset.
+	clen = bc_vm_growSize(a->len, b->len);
+
+	// The layout has to match what bc_num_kScratch() expects.
+	scratch = bc_num_carve(&t, scratch, BC_NUM_KREQ(shrt->len));
+
+	assert(c->cap >= clen);
+	c->len = clen;
+	memset(c->num, 0, BC_NUM_SIZE(c->len));
+
+	for (i = 0; i < lng->len; i += shrt->len) {
+
+		bc_num_slice(lng, i, shrt->len, &chunk);
+
+		if (BC_NUM_ZERO(&chunk)) continue;
+
+		bc_num_zero(&t);
+		bc_num_k(&chunk, shrt, &t, scratch);
+
+		// Every partial sum is less than the whole product, so this never
+		// carries past clen.
+		bc_num_shiftAddSub(c, &t, i, bc_num_addArrays);
+	}
+
+	bc_num_clean(c);
+}
+
+static void bc_num_k(BcNum *a, BcNum *b, BcNum *restrict c,
+                     BcDig *restrict scratch)
+{
+	size_t max, min;
+
+	assert(BC_NUM_ZERO(c));
+	assert(!BC_NUM_NEG(a) && !BC_NUM_NEG(b));
+
+	// This multiplies magnitudes only, and it never allocates: c must already
+	// have a capacity of at least BC_NUM_KREQ() of the longer operand, and
+	// scratch must hold at least bc_num_kScratch() of it.
+
+	if (BC_NUM_ZERO(a) || BC_NUM_ZERO(b)) return;
+	if (BC_NUM_ONE(a) || BC_NUM_ONE(b)) {
+		bc_num_copy(c, BC_NUM_ONE(a) ? b : a);
+		return;
+	}
+	// The brute force products can have a leading zero, and Toom-3 needs its
+	// pointwise products clean to compare and subtract them.
+	if (a->len < BC_NUM_KARATSUBA_LEN || b->len < BC_NUM_KARATSUBA_LEN) {
+		if (a == b) bc_num_s_simp(a, c);
+		else bc_num_m_simp(a, b, c);
+		bc_num_clean(c);
+		return;
+	}
+
+	// The transform has its own buffer because it is a leaf.
+	if (bc_num_nttOk(a->len, b->len)) {
+		bc_num_ntt(a, b, c);
+		return;
+	}
+
+	max = BC_MAX(a->len, b->len);
+	min = BC_MIN(a->len, b->len);
+
+	// Toom-3 only pays off if all three pieces of both operands are nonzero,
+	// and Karatsuba only if both halves of both operands are.
+	if (min >= BC_NUM_TOOM3_LEN && min > (max + 2) / 3 * 2)
+		bc_num_toom3(a, b, c, scratch);
+	else if (min > (max + 1) / 2) bc_num_kara(a, b, c, scratch);
+	else bc_num_unbal(a, b, c, scratch);
+}
+
+static bool bc_num_mulShort(const BcNum *a, const BcNum *b,
+                            BcNum *restrict c, size_t drop)
+{
+	size_t i, k, m, max, clen, terms = 0, limit;
+	BcBigDig lo;
+
+	assert(BC_NUM_ZERO(c));
+
+	// This puts the product of a and b in c, but only the digits from drop up
+	// are right; the ones below are left as zero. It skips every column below
+	// k = drop - 2, and the two guard digits at k and k + 1 tell whether what
+	// was skipped could have carried up into drop. If it could, or if the
+	// columns that are left are not cheaper than the whole product, this
+	// returns false, and the caller has to do the whole product.
+	if (drop <= 2 || BC_NUM_ZERO(a) || BC_NUM_ZERO(b)) return false;
+
+	k = drop - 2;
+	m = BC_MIN(a->len, b->len);
+	max = BC_MAX(a->len, b->len);
+	clen = bc_vm_growSize(a->len, b->len);
+
+	if (m >= (size_t) BC_BASE_POW) return false;
+
+	// The whole product is below drop.
+	if (k >= clen) return true;
+
+	// If the whole product would be schoolbook, this is worth it as long as it
+	// skips a good part of it. Past that, the whole product is subquadratic,
+	// so this has to be no more than a strip about as wide as the Karatsuba
+	// threshold.
+	if (m < BC_NUM_KARATSUBA_LEN) limit = m * max - m * max / 8;
+	else limit = m * BC_NUM_KARATSUBA_LEN * 2;
+
+	for (i = 0; i < a->len && terms <= limit; ++i)
+		terms += b->len - BC_MIN(b->len, k > i ? k - i : 0);
+
+	if (terms > limit) return false;
+
+	bc_num_m_high(a, b, c, k);
+
+	// What was skipped is less than m * BC_BASE_POW^(k + 1), so if the guard
+	// digits have at least that much room before they roll over, nothing from
+	// below could have changed drop or anything above it.
+	lo = ((BcBigDig) c->num[k + 1]) * BC_BASE_POW + (BcBigDig) c->num[k];
+
+	if (lo >= (BC_BASE_POW - (BcBigDig) m) * BC_BASE_POW) {
+		bc_num_zero(c);
+		return false;
+	}
+
+	bc_num_clean(c);
+
+	return true;
+}
+
+static void bc_num_m(BcNum *a, BcNum *b, BcNum *restrict c, size_t scale) {
+
+	BcNum cpa, cpb, *ptr_b;
+	BcDig *scratch = NULL;
+	size_t ascale, bscale, ardx, brdx, azero = 0, bzero = 0, zero, len, rscale;
+	size_t max, drop;
+	bool sqr = (a == b);
+
+	assert(BC_NUM_RDX_VALID(a));
+	assert(BC_NUM_RDX_VALID(b));
+
+	bc_num_zero(c);
+	ascale = a->scale;
+	bscale = b->scale;
+	scale = BC_MAX(scale, ascale);
+	scale = BC_MAX(scale, bscale);
+
+	rscale = ascale + bscale;
+	scale = BC_MIN(rscale, scale);
+
+	if ((a->len == 1 || b->len == 1) && !a->rdx && !b->rdx) {
+
+		BcNum *operand;
+		BcBigDig dig;
+
+		if (a->len == 1) {
+			dig = (BcBigDig) a->num[0];
+			operand = b;
+		}
+		else {
+			dig = (BcBigDig) b->num[0];
+			operand = a;
+		}
+
+		bc_num_mulArray(operand, dig, c);
+
+		if (BC_NUM_NONZERO(c))
+			c->rdx = BC_NUM_NEG_VAL(c, BC_NUM_NEG(a) != BC_NUM_NEG(b));
 
-	azero = bc_num_shiftZero(&cpa);
-	bzero = bc_num_shiftZero(&cpb);
+		return;
+	}
+
+	assert(BC_NUM_RDX_VALID(a));
+	assert(BC_NUM_RDX_VALID(b));
+
+	// A square only needs one copy, and passing the same copy twice is what
+	// tells bc_num_k() that it can use the squaring kernels.
+	ptr_b = sqr ? &cpa : &cpb;
+
+	BC_SIG_LOCK;
+
+	bc_num_init(&cpa, a->len + BC_NUM_RDX_VAL(a));
+	if (!sqr) bc_num_init(&cpb, b->len + BC_NUM_RDX_VAL(b));
 
 	BC_SETJMP_LOCKED(err);
 
 	BC_SIG_UNLOCK;
 
+	bc_num_copy(&cpa, a);
+	assert(BC_NUM_RDX_VALID_NP(cpa));
+	BC_NUM_NEG_CLR_NP(cpa);
+	assert(BC_NUM_RDX_VALID_NP(cpa));
+
+	ardx = BC_NUM_RDX_VAL_NP(cpa) * BC_BASE_DIGS;
+	bc_num_shiftLeft(&cpa, ardx);
+
+	if (!sqr) {
+
+		bc_num_copy(&cpb, b);
+		assert(BC_NUM_RDX_VALID_NP(cpb));
+		BC_NUM_NEG_CLR_NP(cpb);
+		assert(BC_NUM_RDX_VALID_NP(cpb));
+
+		brdx = BC_NUM_RDX_VAL_NP(cpb) * BC_BASE_DIGS;
+		bc_num_shiftLeft(&cpb, brdx);
+	}
+	else brdx = ardx;
+
+	// We need to reset the jump here because azero, bzero, and scratch are used
+	// in the cleanup, and local variables are not guaranteed to be the same
+	// after a jump.
+	BC_SIG_LOCK;
+
+	BC_UNSETJMP;
+
+	azero = bc_num_shiftZero(&cpa);
+	if (!sqr) bzero = bc_num_shiftZero(&cpb);
+	else bzero = azero;
+
 	bc_num_clean(&cpa);
-	bc_num_clean(&cpb);
+	if (!sqr) bc_num_clean(&cpb);
+
+	max = BC_MAX(cpa.len, ptr_b->len);
+
+	// All of the temporaries for Karatsuba and Toom-3, at every level of the
+	// recursion, come out of this one allocation.
+	if (cpa.len >= BC_NUM_KARATSUBA_LEN && ptr_b->len >= BC_NUM_KARATSUBA_LEN &&
+	    !bc_num_nttOk(cpa.len, ptr_b->len))
+	{
+		scratch = bc_vm_malloc(bc_vm_arraySize(bc_num_kScratch(max),
+		                                       sizeof(BcDig)));
+	}
+
+	BC_SETJMP_LOCKED(err);
+
+	BC_SIG_UNLOCK;
 
-	bc_num_k(&cpa, &cpb, c);
+	bc_num_expand(c, BC_NUM_KREQ(max));
 
 	zero = bc_vm_growSize(azero, bzero);
+
+	// Digits of the product below drop are cut off by scale at the end, so if
+	// there are enough of them, they are not computed at all.
+	drop = (ardx + brdx) / BC_BASE_DIGS - BC_NUM_RDX(scale);
+	drop = drop > zero ? drop - zero : 0;
+
+	if (!bc_num_mulShort(&cpa, ptr_b, c, drop))
+		bc_num_k(&cpa, ptr_b, c, scratch);
+
 	len = bc_vm_growSize(c->len, zero);
 
 	bc_num_expand(c, len);
@@ -976,8 +2495,11 @@ static void bc_num_m(BcNum *a, BcNum *b, BcNum *restrict c, size_t scale) {
 
 err:
 	BC_SIG_MAYLOCK;
-	bc_num_unshiftZero(&cpb, bzero);
-	bc_num_free(&cpb);
+	free(scratch);
+	if (!sqr) {
+		bc_num_unshiftZero(&cpb, bzero);
+		bc_num_free(&cpb);
+	}
 	bc_num_unshiftZero(&cpa, azero);
 	bc_num_free(&cpa);
 	BC_LONGJMP_CONT;
@@ -1128,9 +2650,248 @@ err:
 	BC_LONGJMP_CONT;
 }
 
+static void bc_num_mulHigh(BcNum *a, BcNum *b, BcNum *restrict c, size_t k) {
+
+	BcNum ah, *t;
+	size_t j;
+
+	assert(!BC_NUM_RDX_VAL(a) && !BC_NUM_RDX_VAL(b));
+	assert(!BC_NUM_NEG(a) && !BC_NUM_NEG(b));
+
+	// This puts a * b in c, except that only floor(c / BC_BASE_POW^k) is used
+	// by the caller, and that may be one less than it would be with the real
+	// product. That lets this skip the work that goes into the digits below
+	// k, which the Newton steps in division throw away.
+	if (a->len < b->len) {
+		t = a;
+		a = b;
+		b = t;
+	}
+
+	bc_num_zero(c);
+
+	// If the full product would be schoolbook anyway, the columns below k - 1
+	// are just skipped, which takes off less than BC_BASE_POW^k.
+	if (b->len < BC_NUM_KARATSUBA_LEN && k >= 2 && BC_NUM_NONZERO(b) &&
+	    k - 2 < a->len + b->len)
+	{
+		bc_num_m_high(a, b, c, k - 2);
+		bc_num_clean(c);
+		return;
+	}
+
+	// Otherwise, the digits of a below j are dropped. They are less than
+	// BC_BASE_POW^j, and b is less than BC_BASE_POW^(k - j), so that also
+	// takes off less than BC_BASE_POW^k, and a is made about as short as b.
+	j = k > b->len ? BC_MIN(k - b->len, a->len) : 0;
+
+	bc_num_slice(a, j, a->len - j, &ah);
+	bc_num_mul(&ah, b, c, 0);
+	bc_num_shiftLeft(c, j * BC_BASE_DIGS);
+}
+
+static void bc_num_recip(BcNum *restrict a, BcNum *restrict x) {
+
+	BcNum ah, xh, t, t2, pow, tm, u, one;
+	BcDig one_digs[2];
+	size_t i, n = a->len, l, h;
+
+	assert(BC_NUM_NONZERO(a) && !BC_NUM_RDX_VAL(a) && !BC_NUM_NEG(a));
+	assert((BcBigDig) a->num[n - 1] >= BC_BASE_POW / 2);
+
+	// This is ApproximateReciprocal from Brent and Zimmermann's "Modern
+	// Computer Arithmetic" (Algorithm 3.5). a must be normalized (its top digit
+	// must be at least half of BC_BASE_POW), and x comes out as an
+	// approximation of BC_BASE_POW^(2n) / a with a * x < BC_BASE_POW^(2n) <=
+	// a * (x + 2). It finds the reciprocal of the top half of a recursively
+	// and then does one Newton step with two multiplications, so it costs a
+	// small constant times one multiplication of size n.
+
+	l = (n - 1) / 2;
+	h = n - l;
+
+	bc_num_setup(&one, one_digs, sizeof(one_digs) / sizeof(BcDig));
+	bc_num_one(&one);
+
+	BC_SIG_LOCK;
+
+	bc_num_init(&xh, bc_vm_growSize(h, 2));
+	bc_num_init(&t, bc_vm_growSize(n, n));
+	bc_num_init(&t2, bc_vm_growSize(n, h));
+	bc_num_init(&pow, bc_vm_growSize(bc_vm_growSize(n, h), 1));
+
+	BC_SETJMP_LOCKED(err);
+
+	BC_SIG_UNLOCK;
+
+	// Below the threshold, long division is faster, and it is exact.
+	if (n < BC_NUM_NEWTON_LEN) {
+
+		for (i = 0; i < 2 * n; ++i) t.num[i] = BC_BASE_POW - 1;
+		t.len = 2 * n;
+
+		bc_num_div(&t, a, x, 0);
+
+		goto err;
+	}
+
+	bc_num_slice(a, l, h, &ah);
+	bc_num_recip(&ah, &xh);
+
+	bc_num_mul(a, &xh, &t, 0);
+
+	while (t.len > n + h) {
+		bc_num_sub(&xh, &one, &t2, 0);
+		bc_num_copy(&xh, &t2);
+		bc_num_sub(&t, a, &t2, 0);
+		bc_num_copy(&t, &t2);
+	}
+
+	bc_num_one(&pow);
+	bc_num_shiftLeft(&pow, (n + h) * BC_BASE_DIGS);
+	bc_num_sub(&pow, &t, &t2, 0);
+
+	assert(!BC_NUM_NEG_NP(t2));
+
+	bc_num_slice(&t2, l, t2.len, &tm);
+	bc_num_mul(&tm, &xh, &t, 0);
+	bc_num_slice(&t, 2 * h - l, t.len, &u);
+
+	bc_num_shiftLeft(&xh, l * BC_BASE_DIGS);
+	bc_num_add(&xh, &u, x, 0);
+
+err:
+	BC_SIG_MAYLOCK;
+	bc_num_free(&pow);
+	bc_num_free(&t2);
+	bc_num_free(&t);
+	bc_num_free(&xh);
+	BC_LONGJMP_CONT;
+}
+
+static void bc_num_d_newton(BcNum *restrict a, BcNum *restrict b,
+                            BcNum *restrict c, size_t scale)
+{
+	BcNum n, d, fb, fn, bt, nt, qv, x, q, r, t, one, *ptr_bt, *ptr_nt;
+	BcDig one_digs[2];
+	BcBigDig f;
+	size_t m, k, s, rdx;
+
+	assert(!BC_NUM_RDX_VAL(b) && BC_NUM_NONZERO(b));
+
+	bc_num_expand(c, a->len);
+	memset(c->num, 0, BC_NUM_SIZE(c->cap));
+
+	BC_NUM_RDX_SET(c, BC_NUM_RDX_VAL(a));
+	c->scale = a->scale;
+	c->len = a->len;
+
+	assert(c->scale >= scale);
+	rdx = BC_NUM_RDX_VAL(c) - BC_NUM_RDX(scale);
+
+	// Like bc_num_d_long(), this puts floor(n / b) at rdx, where n is the
+	// digits of a from rdx up, but it does it by multiplying n with an
+	// approximate reciprocal of b and then fixing the result up with the exact
+	// remainder. That makes it a few multiplications instead of O(n^2).
+	// Both are sliced so that only their magnitudes are used; the signs are
+	// fixed up by the caller.
+	bc_num_slice(a, rdx, a->len - rdx, &n);
+	bc_num_slice(b, 0, b->len, &d);
+	m = d.len;
+
+	if (bc_num_cmp(&n, &d) < 0) return;
+
+	k = n.len - m + 1;
+	s = bc_vm_growSize(k, 1);
+
+	bc_num_setup(&one, one_digs, sizeof(one_digs) / sizeof(BcDig));
+	bc_num_one(&one);
+
+	BC_SIG_LOCK;
+
+	bc_num_init(&fb, bc_vm_growSize(BC_MAX(m, s), 1));
+	bc_num_init(&fn, bc_vm_growSize(n.len, s));
+	bc_num_init(&x, bc_vm_growSize(s, 2));
+	bc_num_init(&q, bc_vm_growSize(k, 1));
+	bc_num_init(&r, bc_vm_growSize(n.len, 1));
+	bc_num_init(&t, bc_vm_growSize(n.len, s));
+
+	BC_SETJMP_LOCKED(err);
+
+	BC_SIG_UNLOCK;
+
+	// Normalize b so that its top digit is at least half of BC_BASE_POW, which
+	// the reciprocal needs. Multiplying n by the same factor keeps the
+	// quotient the same, and it cannot make d any longer.
+	f = BC_BASE_POW / ((BcBigDig) d.num[m - 1] + 1);
+
+	bc_num_mulArray(&d, f, &fb);
+	bc_num_mulArray(&n, f, &fn);
+
+	assert(fb.len == m && (BcBigDig) fb.num[m - 1] >= BC_BASE_POW / 2);
+
+	// Only the top s digits of b matter for a quotient of k digits, so b is
+	// cut down (or padded) to exactly s digits, and n along with it. The
+	// quotient of those is at most two more than the real one.
+	if (m >= s) {
+		bc_num_slice(&fb, m - s, s, &bt);
+		bc_num_slice(&fn, m - s, fn.len, &nt);
+		ptr_bt = &bt;
+		ptr_nt = &nt;
+	}
+	else {
+		bc_num_shiftLeft(&fb, (s - m) * BC_BASE_DIGS);
+		bc_num_shiftLeft(&fn, (s - m) * BC_BASE_DIGS);
+		ptr_bt = &fb;
+		ptr_nt = &fn;
+	}
+
+	assert(ptr_nt->len < 2 * s);
+
+	// Only the digits of the product from 2 * s up are used, so it does not
+	// need to be exact below that. That can make the estimate one less.
+	bc_num_recip(ptr_bt, &x);
+	bc_num_mulHigh(ptr_nt, &x, &t, 2 * s);
+	bc_num_slice(&t, 2 * s, t.len, &qv);
+	bc_num_copy(&q, &qv);
+
+	// The estimate is off by a few at most, so this finds the exact quotient
+	// by making sure that 0 <= n - q * b < b.
+	bc_num_mul(&q, &d, &t, 0);
+	bc_num_sub(&n, &t, &r, 0);
+
+	while (BC_NUM_NEG_NP(r)) {
+		bc_num_sub(&q, &one, &t, 0);
+		bc_num_copy(&q, &t);
+		bc_num_add(&r, &d, &t, 0);
+		bc_num_copy(&r, &t);
+	}
+
+	while (bc_num_cmp(&r, &d) >= 0) {
+		bc_num_add(&q, &one, &t, 0);
+		bc_num_copy(&q, &t);
+		bc_num_sub(&r, &d, &t, 0);
+		bc_num_copy(&r, &t);
+	}
+
+	assert(rdx + q.len <= c->len);
+
+	memcpy(c->num + rdx, q.num, BC_NUM_SIZE(q.len));
+
+err:
+	BC_SIG_MAYLOCK;
+	bc_num_free(&t);
+	bc_num_free(&r);
+	bc_num_free(&q);
+	bc_num_free(&x);
+	bc_num_free(&fn);
+	bc_num_free(&fb);
+	BC_LONGJMP_CONT;
+}
+
 static void bc_num_d(BcNum *a, BcNum *b, BcNum *restrict c, size_t scale) {
 
-	size_t len, cpardx;
+	size_t len, cpardx, rdx;
 	BcNum cpa, cpb;
 
 	if (BC_NUM_ZERO(b)) bc_vm_err(BC_ERR_MATH_DIVIDE_BY_ZERO);
@@ -1193,7 +2954,16 @@ static void bc_num_d(BcNum *a, BcNum *b, BcNum *restrict c, size_t scale) {
 	cpb.scale = 0;
 	BC_NUM_RDX_SET_NP(cpb, 0);
 
-	bc_num_d_long(&cpa, &cpb, c, scale);
+	// Both of these only need the digits of cpa from rdx up, and long division
+	// is faster unless both the divisor and the quotient are long.
+	rdx = BC_NUM_RDX_VAL_NP(cpa) - BC_NUM_RDX(scale);
+
+	if (cpb.len >= BC_NUM_NEWTON_LEN &&
+	    cpa.len - rdx >= cpb.len + BC_NUM_NEWTON_LEN)
+	{
+		bc_num_d_newton(&cpa, &cpb, c, scale);
+	}
+	else bc_num_d_long(&cpa, &cpb, c, scale);
 
 	bc_num_retireMul(c, scale, BC_NUM_NEG(a), BC_NUM_NEG(b));
 
@@ -1316,7 +3086,7 @@ static void bc_num_p(BcNum *a, BcNum *b, BcNum *restrict c, size_t scale) {
 	for (powrdx = a->scale; !(pow & 1); pow >>= 1) {
 		powrdx <<= 1;
 		assert(BC_NUM_RDX_VALID_NP(copy));
-		bc_num_mul(&copy, &copy, &copy, powrdx);
+		bc_num_sqr(&copy, &copy, powrdx);
 	}
 
 	bc_num_copy(c, &copy);
@@ -1326,7 +3096,7 @@ static void bc_num_p(BcNum *a, BcNum *b, BcNum *restrict c, size_t scale) {
 
 		powrdx <<= 1;
 		assert(BC_NUM_RDX_VALID_NP(copy));
-		bc_num_mul(&copy, &copy, &copy, powrdx);
+		bc_num_sqr(&copy, &copy, powrdx);
 
 		if (pow & 1) {
 			resrdx += powrdx;
@@ -1558,44 +3328,228 @@ static void bc_num_parseDecimal(BcNum *restrict n, const char *restrict val) {
 	}
 }
 
-static void bc_num_parseBase(BcNum *restrict n, const char *restrict val,
-                             BcBigDig base)
-{
-	BcNum temp, mult1, mult2, result1, result2, *m1, *m2, *ptr;
-	char c = 0;
-	bool zero = true;
-	BcBigDig v;
-	size_t i, digs, len = strlen(val);
+static void bc_num_convBase(BcBigDig base) {
 
-	for (i = 0; zero && i < len; ++i) zero = (val[i] == '.' || val[i] == '0');
-	if (zero) return;
+	// This sets up vm.last_pow and friends for base, and it throws out the
+	// cached powers if they are for a different base.
+	if (base == vm.last_base) return;
+
+	BC_SIG_LOCK;
+
+	bc_vec_popAll(&vm.last_pows);
+
+	BC_SIG_UNLOCK;
+
+	vm.last_pow = 1;
+	vm.last_exp = 0;
+
+	while (vm.last_pow * base <= BC_BASE_POW) {
+		vm.last_pow *= base;
+		vm.last_exp += 1;
+	}
+
+	vm.last_rem = BC_BASE_POW - vm.last_pow;
+	vm.last_base = base;
+}
+
+static void bc_num_convPow(void) {
+
+	BcNum pow, *prev;
+
+	// This adds the next power to vm.last_pows. It is only pushed once it is
+	// done, so the cache is never left with a bad power if this is stopped.
+	BC_SIG_LOCK;
 
+	if (!vm.last_pows.len) {
+		bc_num_createFromBigdig(&pow, vm.last_pow);
+		bc_vec_push(&vm.last_pows, &pow);
+		BC_SIG_UNLOCK;
+		return;
+	}
+
+	prev = bc_vec_top(&vm.last_pows);
+
+	bc_num_init(&pow, bc_vm_growSize(prev->len, prev->len));
+
+	BC_SETJMP_LOCKED(err);
+
+	BC_SIG_UNLOCK;
+
+	bc_num_sqr(prev, &pow, 0);
+
+	BC_SIG_LOCK;
+
+	bc_vec_push(&vm.last_pows, &pow);
+
+	BC_UNSETJMP;
+
+	BC_SIG_UNLOCK;
+
+	return;
+
+err:
+	BC_SIG_MAYLOCK;
+	bc_num_free(&pow);
+	BC_LONGJMP_CONT;
+}
+
+static void bc_num_parseDigits(BcNum *restrict n, const char *restrict val,
+                               size_t len, BcBigDig base)
+{
+	BcNum temp, mult;
+	BcBigDig v, pow;
+	size_t i;
+
+	// This puts the value of the len characters at val in n, which must be
+	// zero, by multiplying by the base and adding each digit. It collects as
+	// many digits as fit in a BcBigDig first, so it only touches n once for
+	// each of those, but it is still quadratic.
 	BC_SIG_LOCK;
 
 	bc_num_init(&temp, BC_NUM_BIGDIG_LOG10);
-	bc_num_init(&mult1, BC_NUM_BIGDIG_LOG10);
+	bc_num_init(&mult, BC_NUM_DEF_SIZE);
 
-	BC_SETJMP_LOCKED(int_err);
+	BC_SETJMP_LOCKED(err);
 
 	BC_SIG_UNLOCK;
 
-	for (i = 0; i < len && (c = val[i]) && c != '.'; ++i) {
+	for (i = 0; i < len;) {
 
-		v = bc_num_parseChar(c, base);
+		for (v = 0, pow = 1; i < len && pow * base <= BC_BASE_POW; ++i) {
+			v = v * base + bc_num_parseChar(val[i], base);
+			pow *= base;
+		}
 
-		bc_num_mulArray(n, base, &mult1);
+		bc_num_mulArray(n, pow, &mult);
 		bc_num_bigdig2num(&temp, v);
-		bc_num_add(&mult1, &temp, n, 0);
+		bc_num_add(&mult, &temp, n, 0);
+	}
+
+err:
+	BC_SIG_MAYLOCK;
+	bc_num_free(&mult);
+	bc_num_free(&temp);
+	BC_LONGJMP_CONT;
+}
+
+static void bc_num_parseConv(BcNum *restrict n, const char *restrict val,
+                             size_t len, BcBigDig base, size_t k)
+{
+	BcNum hi, lo;
+	size_t half;
+
+	// This does the same as bc_num_parseDigits(), but len must be at most
+	// vm.last_exp * 2^k, and it splits the characters so that the low part is
+	// vm.last_exp * 2^(k - 1) of them, which makes it less than the power at
+	// k - 1 in vm.last_pows. Both parts are parsed recursively, and then they
+	// are put back together with one multiplication.
+	if (!k || len < BC_NUM_CONV_LEN * BC_BASE_DIGS) {
+		bc_num_parseDigits(n, val, len, base);
+		return;
 	}
 
-	if (i == len && !val[i]) goto int_err;
+	half = vm.last_exp << (k - 1);
 
-	assert(val[i] == '.');
+	if (len <= half) {
+		bc_num_parseConv(n, val, len, base, k - 1);
+		return;
+	}
 
 	BC_SIG_LOCK;
 
-	BC_UNSETJMP;
+	bc_num_init(&hi, BC_NUM_DEF_SIZE);
+	bc_num_init(&lo, BC_NUM_DEF_SIZE);
+
+	BC_SETJMP_LOCKED(err);
+
+	BC_SIG_UNLOCK;
+
+	bc_num_parseConv(&hi, val, len - half, base, k - 1);
+	bc_num_parseConv(&lo, val + len - half, half, base, k - 1);
+
+	bc_num_mul(&hi, bc_vec_item(&vm.last_pows, k - 1), n, 0);
+	bc_num_add(n, &lo, n, 0);
+
+err:
+	BC_SIG_MAYLOCK;
+	bc_num_free(&lo);
+	bc_num_free(&hi);
+	BC_LONGJMP_CONT;
+}
+
+static size_t bc_num_parsePows(size_t len, BcBigDig base) {
+
+	size_t k;
+
+	// This makes sure that vm.last_pows has every power that
+	// bc_num_parseConv() and bc_num_parsePow() need for len characters, and it
+	// returns the k that they should start with.
+	bc_num_convBase(base);
+
+	for (k = 0; (vm.last_exp << k) < len; ++k);
+
+	while (vm.last_pows.len < k) bc_num_convPow();
+
+	return k;
+}
+
+static void bc_num_parseInt(BcNum *restrict n, const char *restrict val,
+                            size_t len, BcBigDig base)
+{
+	// Short strings are not worth changing the cached powers for.
+	if (len < BC_NUM_CONV_LEN * BC_BASE_DIGS)
+		bc_num_parseDigits(n, val, len, base);
+	else bc_num_parseConv(n, val, len, base, bc_num_parsePows(len, base));
+}
+
+static void bc_num_parsePow(BcNum *restrict n, size_t len, BcBigDig base) {
+
+	size_t i, k = bc_num_parsePows(len + 1, base);
+	BcBigDig pow = 1;
+
+	// This puts base^len in n. The part of len that is a multiple of
+	// vm.last_exp is made from the cached powers, one for each bit, and the
+	// rest is small enough to be a BcBigDig. The powers are made for len + 1
+	// characters so that there is one for the top bit even when len is a
+	// multiple of vm.last_exp.
+	for (i = 0; i < len % vm.last_exp; ++i) pow *= base;
+
+	bc_num_bigdig2num(n, pow);
+
+	for (i = 0; i < k; ++i) {
+		if ((len / vm.last_exp) & (((size_t) 1) << i))
+			bc_num_mul(n, bc_vec_item(&vm.last_pows, i), n, 0);
+	}
+}
+
+static void bc_num_parseBase(BcNum *restrict n, const char *restrict val,
+                             BcBigDig base)
+{
+	BcNum temp, mult1, mult2, result1, result2, *m1, *m2, *ptr;
+	char c = 0;
+	bool zero = true;
+	BcBigDig v;
+	size_t i, digs, len = strlen(val);
+
+	// Constants are parsed again into the same number when ibase changes, so
+	// n might not start out as zero.
+	bc_num_zero(n);
+
+	for (i = 0; zero && i < len; ++i) zero = (val[i] == '.' || val[i] == '0');
+	if (zero) return;
+
+	for (i = 0; i < len && val[i] != '.'; ++i);
 
+	bc_num_parseInt(n, val, i, base);
+
+	if (i == len) return;
+
+	assert(val[i] == '.');
+
+	BC_SIG_LOCK;
+
+	bc_num_init(&temp, BC_NUM_BIGDIG_LOG10);
+	bc_num_init(&mult1, BC_NUM_BIGDIG_LOG10);
 	bc_num_init(&mult2, BC_NUM_BIGDIG_LOG10);
 	bc_num_init(&result1, BC_NUM_DEF_SIZE);
 	bc_num_init(&result2, BC_NUM_DEF_SIZE);
@@ -1608,25 +3562,37 @@ static void bc_num_parseBase(BcNum *restrict n, const char *restrict val,
 	m1 = &mult1;
 	m2 = &mult2;
 
-	for (i += 1, digs = 0; i < len && (c = val[i]); ++i, ++digs) {
+	digs = len - i - 1;
 
-		size_t rdx;
+	// For long fractions, the digits are parsed as one integer, and the power
+	// to divide it by is made from the cached powers, instead of building both
+	// one digit at a time.
+	if (digs >= BC_NUM_CONV_LEN * BC_BASE_DIGS) {
+		bc_num_parseInt(&result1, val + i + 1, digs, base);
+		bc_num_parsePow(m1, digs, base);
+	}
+	else {
 
-		v = bc_num_parseChar(c, base);
+		for (i += 1; i < len && (c = val[i]); ++i) {
 
-		bc_num_mulArray(&result1, base, &result2);
+			size_t rdx;
 
-		bc_num_bigdig2num(&temp, v);
-		bc_num_add(&result2, &temp, &result1, 0);
-		bc_num_mulArray(m1, base, m2);
+			v = bc_num_parseChar(c, base);
+
+			bc_num_mulArray(&result1, base, &result2);
 
-		rdx = BC_NUM_RDX_VAL(m2);
+			bc_num_bigdig2num(&temp, v);
+			bc_num_add(&result2, &temp, &result1, 0);
+			bc_num_mulArray(m1, base, m2);
 
-		if (m2->len < rdx) m2->len = rdx;
+			rdx = BC_NUM_RDX_VAL(m2);
 
-		ptr = m1;
-		m1 = m2;
-		m2 = ptr;
+			if (m2->len < rdx) m2->len = rdx;
+
+			ptr = m1;
+			m1 = m2;
+			m2 = ptr;
+		}
 	}
 
 	// This one cannot be a divide by 0 because mult starts out at 1, then is
@@ -1645,8 +3611,6 @@ err:
 	bc_num_free(&result2);
 	bc_num_free(&result1);
 	bc_num_free(&mult2);
-int_err:
-	BC_SIG_MAYLOCK;
 	bc_num_free(&mult1);
 	bc_num_free(&temp);
 	BC_LONGJMP_CONT;
@@ -1858,6 +3822,185 @@ static void bc_num_printPrepare(BcNum *restrict n, BcBigDig rem,
 	}
 }
 
+static size_t bc_num_printPows(size_t len) {
+
+	size_t i;
+
+	// This makes sure that vm.last_pows goes far enough to have a power with
+	// more than len digits, which is bigger than any number of len digits, and
+	// it returns the index of the first such power.
+	while (!vm.last_pows.len ||
+	       ((BcNum*) bc_vec_top(&vm.last_pows))->len <= len)
+	{
+		bc_num_convPow();
+	}
+
+	for (i = 0; ((BcNum*) bc_vec_item(&vm.last_pows, i))->len <= len; ++i);
+
+	return i;
+}
+
+static void bc_num_printConv(BcNum *restrict n, BcDig *restrict out,
+                             size_t k)
+{
+	BcNum q, r;
+	size_t half = ((size_t) 1) << k;
+
+	// This puts n, which must be less than last_pow^(2^k), in out as 2^k digits
+	// of base last_pow, least significant first, just like
+	// bc_num_printPrepare() would, but it splits n in half by dividing by the
+	// power in the middle and converts both halves recursively, which makes it
+	// subquadratic with fast division.
+
+	BC_SIG_LOCK;
+
+	bc_num_init(&q, n->len);
+	bc_num_init(&r, n->len);
+
+	BC_SETJMP_LOCKED(err);
+
+	BC_SIG_UNLOCK;
+
+	if (!k || n->len < BC_NUM_CONV_LEN) {
+
+		bc_num_copy(&q, n);
+
+		if (vm.last_rem != 0)
+			bc_num_printPrepare(&q, vm.last_rem, vm.last_pow);
+
+		bc_num_clean(&q);
+
+		assert(q.len <= half);
+
+		memcpy(out, q.num, BC_NUM_SIZE(q.len));
+		memset(out + q.len, 0, BC_NUM_SIZE(half - q.len));
+
+		goto err;
+	}
+
+	half >>= 1;
+
+	bc_num_divmod(n, bc_vec_item(&vm.last_pows, k - 1), &q, &r, 0);
+
+	bc_num_printConv(&r, out, k - 1);
+	bc_num_printConv(&q, out + half, k - 1);
+
+err:
+	BC_SIG_MAYLOCK;
+	bc_num_free(&r);
+	bc_num_free(&q);
+	BC_LONGJMP_CONT;
+}
+
+static void bc_num_printInt(BcNum *restrict n) {
+
+	BcNum t;
+	size_t k;
+
+	// This replaces n, which must be an integer, with its digits in base
+	// last_pow, like bc_num_printPrepare(), but with bc_num_printConv().
+	k = bc_num_printPows(n->len);
+
+	BC_SIG_LOCK;
+
+	bc_num_init(&t, ((size_t) 1) << k);
+
+	BC_SETJMP_LOCKED(err);
+
+	BC_SIG_UNLOCK;
+
+	bc_num_printConv(n, t.num, k);
+	t.len = ((size_t) 1) << k;
+	bc_num_clean(&t);
+
+	bc_num_copy(n, &t);
+
+err:
+	BC_SIG_MAYLOCK;
+	bc_num_free(&t);
+	BC_LONGJMP_CONT;
+}
+
+static void bc_num_printFrac(BcNum *restrict n, BcBigDig base, size_t scale,
+                             size_t len, BcNumDigitOp print)
+{
+	BcNum acc, t, f;
+	BcBigDig exp = vm.last_exp, digs[sizeof(BcBigDig) * CHAR_BIT];
+	size_t i, j, k, d = 0, ndigs, limbs;
+	bool radix = true;
+
+	// The fraction n, which has scale digits, needs the first d digits of its
+	// expansion in base, where d is the smallest with base^d >= 10^scale.
+	// Those digits are just floor(n * base^d) in base, padded to d digits, so
+	// this finds base^d with the cached powers of last_pow and then prints
+	// that integer with bc_num_printConv().
+	k = bc_num_printPows(BC_NUM_RDX(scale) + 1);
+
+	BC_SIG_LOCK;
+
+	bc_num_init(&acc, BC_NUM_RDX(scale) + 2);
+	bc_num_init(&t, BC_NUM_RDX(scale) + 2);
+	bc_num_init(&f, bc_vm_growSize(n->len, 1));
+
+	BC_SETJMP_LOCKED(err);
+
+	BC_SIG_UNLOCK;
+
+	bc_num_one(&acc);
+
+	for (i = k; i < k + 1; --i) {
+
+		bc_num_mul(&acc, bc_vec_item(&vm.last_pows, i), &t, 0);
+
+		if (bc_num_intDigits(&t) < scale + 1) {
+			bc_num_copy(&acc, &t);
+			d += (((size_t) 1) << i) * exp;
+		}
+	}
+
+	while (bc_num_intDigits(&acc) < scale + 1) {
+		bc_num_mulArray(&acc, base, &t);
+		bc_num_copy(&acc, &t);
+		d += 1;
+	}
+
+	bc_num_copy(&f, n);
+	bc_num_shiftLeft(&f, scale);
+	bc_num_mul(&f, &acc, &t, 0);
+	bc_num_shiftRight(&t, scale);
+	bc_num_truncate(&t, t.scale);
+
+	bc_num_printInt(&t);
+
+	limbs = (d + exp - 1) / exp;
+
+	assert(t.len <= limbs);
+
+	for (i = limbs - 1; i < limbs; --i) {
+
+		BcBigDig val = i < t.len ? (BcBigDig) t.num[i] : 0;
+
+		ndigs = i == limbs - 1 ? d - (limbs - 1) * exp : exp;
+
+		for (j = 0; j < ndigs; ++j) {
+			digs[j] = val % base;
+			val /= base;
+		}
+
+		for (j = ndigs - 1; j < ndigs; --j) {
+			print(digs[j], len, radix);
+			radix = false;
+		}
+	}
+
+err:
+	BC_SIG_MAYLOCK;
+	bc_num_free(&f);
+	bc_num_free(&t);
+	bc_num_free(&acc);
+	BC_LONGJMP_CONT;
+}
+
 static void bc_num_printNum(BcNum *restrict n, BcBigDig base,
                             size_t len, BcNumDigitOp print)
 {
@@ -1925,23 +4068,14 @@ static void bc_num_printNum(BcNum *restrict n, BcBigDig base,
 
 	bc_num_sub(n, &intp, &fracp1, 0);
 
-	if (base != vm.last_base) {
-
-		vm.last_pow = 1;
-		vm.last_exp = 0;
-
-		while (vm.last_pow * base <= BC_BASE_POW) {
-			vm.last_pow *= base;
-			vm.last_exp += 1;
-		}
-
-		vm.last_rem = BC_BASE_POW - vm.last_pow;
-		vm.last_base = base;
-	}
+	bc_num_convBase(base);
 
 	exp = vm.last_exp;
 
-	if (vm.last_rem != 0) bc_num_printPrepare(&intp, vm.last_rem, vm.last_pow);
+	if (vm.last_rem != 0) {
+		if (intp.len >= BC_NUM_CONV_LEN) bc_num_printInt(&intp);
+		else bc_num_printPrepare(&intp, vm.last_rem, vm.last_pow);
+	}
 
 	for (i = 0; i < intp.len; ++i) {
 
@@ -1974,6 +4108,11 @@ static void bc_num_printNum(BcNum *restrict n, BcBigDig base,
 
 	if (!n->scale) goto err;
 
+	if (BC_NUM_RDX(n->scale) >= BC_NUM_CONV_LEN) {
+		bc_num_printFrac(&fracp1, base, n->scale, len, print);
+		goto err;
+	}
+
 	BC_SIG_LOCK;
 
 	BC_UNSETJMP;
@@ -2067,6 +4206,7 @@ void bc_num_setup(BcNum *restrict n, BcDig *restrict num, size_t cap) {
 	assert(n != NULL);
 	n->num = num;
 	n->cap = cap;
+	n->ref = false;
 	bc_num_zero(n);
 }
 
@@ -2080,19 +4220,16 @@ void bc_num_init(BcNum *restrict n, size_t req) {
 
 	req = req >= BC_NUM_DEF_SIZE ? req : BC_NUM_DEF_SIZE;
 
-	if (req == BC_NUM_DEF_SIZE && vm.temps.len) {
-		BcNum *nptr = bc_vec_top(&vm.temps);
-		num = nptr->num;
-		bc_vec_pop(&vm.temps);
-	}
-	else num = bc_vm_malloc(BC_NUM_SIZE(req));
+	num = bc_num_alloc(&req);
 
 	bc_num_setup(n, num, req);
+	n->ref = true;
 }
 
 void bc_num_clear(BcNum *restrict n) {
 	n->num = NULL;
 	n->cap = 0;
+	n->ref = false;
 }
 
 void bc_num_free(void *num) {
@@ -2103,8 +4240,12 @@ void bc_num_free(void *num) {
 
 	assert(n != NULL);
 
-	if (n->cap == BC_NUM_DEF_SIZE) bc_vec_push(&vm.temps, n);
-	else free(n->num);
+	if (n->num == NULL) return;
+
+	assert(n->ref);
+
+	if (bc_num_shared(n)) *bc_num_refs(n->num) -= 1;
+	else bc_num_dealloc(n->num, n->cap);
 }
 
 void bc_num_copy(BcNum *d, const BcNum *s) {
@@ -2124,6 +4265,23 @@ void bc_num_createCopy(BcNum *d, const BcNum *s) {
 	bc_num_copy(d, s);
 }
 
+void bc_num_share(BcNum *d, const BcNum *s) {
+
+	BC_SIG_ASSERT_LOCKED;
+
+	assert(d != NULL && s != NULL && d != s);
+
+	// Numbers whose digits are not from bc_num_init() have nowhere to keep a
+	// reference count.
+	if (!s->ref) {
+		bc_num_createCopy(d, s);
+		return;
+	}
+
+	*bc_num_refs(s->num) += 1;
+	memcpy(d, s, sizeof(BcNum));
+}
+
 void bc_num_createFromBigdig(BcNum *n, BcBigDig val) {
 	BC_SIG_ASSERT_LOCKED;
 	bc_num_init(n, BC_NUM_BIGDIG_LOG10);
@@ -2164,6 +4322,8 @@ void bc_num_parse(BcNum *restrict n, const char *restrict val, BcBigDig base) {
 	assert(base >= BC_NUM_MIN_BASE && base <= vm.maxes[BC_PROG_GLOBALS_IBASE]);
 	assert(bc_num_strValid(val));
 
+	bc_num_own(n);
+
 	if (!val[1]) {
 		BcBigDig dig = bc_num_parseChar(val[0], BC_NUM_MAX_LBASE);
 		bc_num_bigdig2num(n, dig);
@@ -2609,12 +4769,14 @@ size_t bc_num_placesReq(const BcNum *a, const BcNum *b, size_t scale) {
 void bc_num_add(BcNum *a, BcNum *b, BcNum *c, size_t scale) {
 	assert(BC_NUM_RDX_VALID(a));
 	assert(BC_NUM_RDX_VALID(b));
+	if (c == a && bc_num_asInPlace(a, b, false)) return;
 	bc_num_binary(a, b, c, false, bc_num_as, bc_num_addReq(a, b, scale));
 }
 
 void bc_num_sub(BcNum *a, BcNum *b, BcNum *c, size_t scale) {
 	assert(BC_NUM_RDX_VALID(a));
 	assert(BC_NUM_RDX_VALID(b));
+	if (c == a && bc_num_asInPlace(a, b, true)) return;
 	bc_num_binary(a, b, c, true, bc_num_as, bc_num_addReq(a, b, scale));
 }
 
@@ -2624,6 +4786,11 @@ void bc_num_mul(BcNum *a, BcNum *b, BcNum *c, size_t scale) {
 	bc_num_binary(a, b, c, scale, bc_num_m, bc_num_mulReq(a, b, scale));
 }
 
+void bc_num_sqr(BcNum *a, BcNum *c, size_t scale) {
+	assert(BC_NUM_RDX_VALID(a));
+	bc_num_binary(a, a, c, scale, bc_num_m, bc_num_mulReq(a, a, scale));
+}
+
 void bc_num_div(BcNum *a, BcNum *b, BcNum *c, size_t scale) {
 	assert(BC_NUM_RDX_VALID(a));
 	assert(BC_NUM_RDX_VALID(b));
@@ -2649,24 +4816,250 @@ void bc_num_places(BcNum *a, BcNum *b, BcNum *c, size_t scale) {
 	bc_num_binary(a, b, c, scale, bc_num_place, bc_num_placesReq(a, b, scale));
 }
 
-void bc_num_lshift(BcNum *a, BcNum *b, BcNum *c, size_t scale) {
-	assert(BC_NUM_RDX_VALID(a));
-	assert(BC_NUM_RDX_VALID(b));
-	bc_num_binary(a, b, c, scale, bc_num_left, bc_num_placesReq(a, b, scale));
-}
+void bc_num_lshift(BcNum *a, BcNum *b, BcNum *c, size_t scale) {
+	assert(BC_NUM_RDX_VALID(a));
+	assert(BC_NUM_RDX_VALID(b));
+	bc_num_binary(a, b, c, scale, bc_num_left, bc_num_placesReq(a, b, scale));
+}
+
+void bc_num_rshift(BcNum *a, BcNum *b, BcNum *c, size_t scale) {
+	assert(BC_NUM_RDX_VALID(a));
+	assert(BC_NUM_RDX_VALID(b));
+	bc_num_binary(a, b, c, scale, bc_num_right, bc_num_placesReq(a, b, scale));
+}
+#endif // BC_ENABLE_EXTRA_MATH
+
+static void bc_num_sqrtDiv(BcNum *restrict a, BcNum *restrict b,
+                           size_t scale)
+{
+	BcNum num1, num2, half, f, fprime, *x0, *x1, *temp;
+	size_t pow, len, rdx, resscale;
+	BcDig half_digs[1];
+
+	rdx = BC_NUM_RDX(scale);
+	rdx = BC_MAX(rdx, BC_NUM_RDX_VAL(a));
+	len = bc_vm_growSize(a->len, rdx);
+
+	BC_SIG_LOCK;
+
+	bc_num_init(&num1, len);
+	bc_num_init(&num2, len);
+	bc_num_setup(&half, half_digs, sizeof(half_digs) / sizeof(BcDig));
+
+	bc_num_one(&half);
+	half.num[0] = BC_BASE_POW / 2;
+	half.len = 1;
+	BC_NUM_RDX_SET_NP(half, 1);
+	half.scale = 1;
+
+	bc_num_init(&f, len);
+	bc_num_init(&fprime, len);
+
+	BC_SETJMP_LOCKED(err);
+
+	BC_SIG_UNLOCK;
+
+	x0 = &num1;
+	x1 = &num2;
+
+	bc_num_one(x0);
+	pow = bc_num_intDigits(a);
+
+	if (pow) {
+
+		if (pow & 1) x0->num[0] = 2;
+		else x0->num[0] = 6;
+
+		pow -= 2 - (pow & 1);
+		bc_num_shiftLeft(x0, pow / 2);
+	}
+
+	// I can set the rdx here directly because neg should be false.
+	x0->scale = x0->rdx = 0;
+	resscale = (scale + BC_BASE_DIGS) + 2;
+
+	while (bc_num_cmp(x1, x0)) {
+
+		assert(BC_NUM_NONZERO(x0));
+
+		bc_num_div(a, x0, &f, resscale);
+		bc_num_add(x0, &f, &fprime, resscale);
+
+		assert(BC_NUM_RDX_VALID_NP(fprime));
+		assert(BC_NUM_RDX_VALID_NP(half));
+
+		bc_num_mul(&fprime, &half, x1, resscale);
+
+		temp = x0;
+		x0 = x1;
+		x1 = temp;
+	}
+
+	bc_num_copy(b, x0);
+	if (b->scale > scale) bc_num_truncate(b, b->scale - scale);
+
+err:
+	BC_SIG_MAYLOCK;
+	bc_num_free(&fprime);
+	bc_num_free(&f);
+	bc_num_free(&num2);
+	bc_num_free(&num1);
+	BC_LONGJMP_CONT;
+}
+
+static void bc_num_rsqrt(BcNum *restrict a, BcNum *restrict y, size_t p) {
+
+	BcNum at, t, u, half, one;
+	BcDig half_digs[1], one_digs[2];
+	size_t w = bc_vm_growSize(p, BC_BASE_DIGS), len;
+
+	assert(!BC_NUM_NEG(a) && bc_num_intDigits(a) >= 1 &&
+	       bc_num_intDigits(a) <= 2);
+
+	// This puts about p correct digits of 1 / sqrt(a) in y, where a is in
+	// [1, 100). It gets half as many digits recursively and then does one
+	// Newton step, y += y * (1 - a * y^2) / 2, which doubles them with
+	// multiplications only.
+
+	len = bc_vm_growSize(BC_NUM_RDX(w), 2);
+
+	bc_num_setup(&half, half_digs, sizeof(half_digs) / sizeof(BcDig));
+	bc_num_one(&half);
+	half.num[0] = BC_BASE_POW / 2;
+	BC_NUM_RDX_SET_NP(half, 1);
+	half.scale = 1;
+
+	bc_num_setup(&one, one_digs, sizeof(one_digs) / sizeof(BcDig));
+	bc_num_one(&one);
+
+	BC_SIG_LOCK;
+
+	bc_num_init(&at, bc_vm_growSize(a->len, 1));
+	bc_num_init(&t, bc_vm_growSize(len, len));
+	bc_num_init(&u, bc_vm_growSize(len, len));
+
+	BC_SETJMP_LOCKED(err);
+
+	BC_SIG_UNLOCK;
+
+	// Only the first w digits of a matter at this precision.
+	bc_num_copy(&at, a);
+	if (at.scale > w) bc_num_truncate(&at, at.scale - w);
+
+	// Below the threshold, the old way with divisions is faster.
+	if (BC_NUM_RDX(p) < BC_NUM_SQRT_LEN) {
+		bc_num_sqrtDiv(&at, &t, w);
+		bc_num_div(&one, &t, y, w);
+		goto err;
+	}
+
+	bc_num_rsqrt(&at, y, p / 2 + BC_BASE_DIGS);
+
+	bc_num_sqr(y, &t, w);
+	bc_num_mul(&at, &t, &u, w);
+	bc_num_sub(&one, &u, &t, w);
+	bc_num_mul(y, &t, &u, w);
+	bc_num_mul(&u, &half, &t, w);
+	bc_num_add(y, &t, &u, w);
+	bc_num_copy(y, &u);
+
+err:
+	BC_SIG_MAYLOCK;
+	bc_num_free(&u);
+	bc_num_free(&t);
+	bc_num_free(&at);
+	BC_LONGJMP_CONT;
+}
+
+static void bc_num_sqrtFast(BcNum *restrict a, BcNum *restrict b,
+                            size_t scale)
+{
+	BcNum n, an, y, s, r, t, one;
+	BcDig one_digs[2];
+	size_t j, p, w, len;
+
+	// The answer is floor(sqrt(n)) / 10^scale, where n = a * 10^(2 * scale) is
+	// an integer. n is scaled by an even power of ten to be in [1, 100), its
+	// reciprocal square root is found with multiplications only, and one more
+	// multiplication gives the square root. That is then made exact with the
+	// remainder, so it is always truncated, just like the old way.
+	len = bc_vm_growSize(bc_vm_growSize(a->len, BC_NUM_RDX(2 * scale)), 1);
+
+	bc_num_setup(&one, one_digs, sizeof(one_digs) / sizeof(BcDig));
+	bc_num_one(&one);
+
+	BC_SIG_LOCK;
+
+	bc_num_init(&n, len);
+	bc_num_init(&an, len);
+	bc_num_init(&y, len);
+	bc_num_init(&s, len);
+	bc_num_init(&r, len);
+	bc_num_init(&t, len);
+
+	BC_SETJMP_LOCKED(err);
+
+	BC_SIG_UNLOCK;
+
+	bc_num_copy(&n, a);
+	bc_num_shiftLeft(&n, 2 * scale);
+
+	assert(!n.scale && BC_NUM_NONZERO(&n));
+
+	j = (bc_num_intDigits(&n) - 1) / 2;
+	p = bc_vm_growSize(j, 1 + BC_BASE_DIGS);
+	w = bc_vm_growSize(p, BC_BASE_DIGS);
+
+	bc_num_copy(&an, &n);
+	bc_num_shiftRight(&an, 2 * j);
+	if (an.scale > w) bc_num_truncate(&an, an.scale - w);
+
+	bc_num_rsqrt(&an, &y, p);
+	bc_num_mul(&an, &y, &s, w);
+
+	bc_num_shiftLeft(&s, j);
+	bc_num_truncate(&s, s.scale);
+
+	// s is off by a little at most. r = n - s^2 must end up in [0, 2s].
+	bc_num_sqr(&s, &t, 0);
+	bc_num_sub(&n, &t, &r, 0);
+
+	while (BC_NUM_NEG_NP(r)) {
+		bc_num_sub(&s, &one, &t, 0);
+		bc_num_copy(&s, &t);
+		bc_num_add(&r, &s, &t, 0);
+		bc_num_add(&t, &s, &r, 0);
+		bc_num_add(&r, &one, &t, 0);
+		bc_num_copy(&r, &t);
+	}
+
+	bc_num_add(&s, &s, &t, 0);
 
-void bc_num_rshift(BcNum *a, BcNum *b, BcNum *c, size_t scale) {
-	assert(BC_NUM_RDX_VALID(a));
-	assert(BC_NUM_RDX_VALID(b));
-	bc_num_binary(a, b, c, scale, bc_num_right, bc_num_placesReq(a, b, scale));
+	while (bc_num_cmp(&r, &t) > 0) {
+		bc_num_sub(&r, &t, &y, 0);
+		bc_num_sub(&y, &one, &r, 0);
+		bc_num_add(&s, &one, &y, 0);
+		bc_num_copy(&s, &y);
+		bc_num_add(&s, &s, &t, 0);
+	}
+
+	bc_num_copy(b, &s);
+	bc_num_shiftRight(b, scale);
+
+err:
+	BC_SIG_MAYLOCK;
+	bc_num_free(&t);
+	bc_num_free(&r);
+	bc_num_free(&s);
+	bc_num_free(&y);
+	bc_num_free(&an);
+	bc_num_free(&n);
+	BC_LONGJMP_CONT;
 }
-#endif // BC_ENABLE_EXTRA_MATH
 
 void bc_num_sqrt(BcNum *restrict a, BcNum *restrict b, size_t scale) {
 
-	BcNum num1, num2, half, f, fprime, *x0, *x1, *temp;
-	size_t pow, len, rdx, req, resscale;
-	BcDig half_digs[1];
+	size_t len, rdx, req;
 
 	assert(a != NULL && b != NULL && a != b);
 
@@ -2697,80 +5090,16 @@ void bc_num_sqrt(BcNum *restrict a, BcNum *restrict b, size_t scale) {
 		return;
 	}
 
-	rdx = BC_NUM_RDX(scale);
-	rdx = BC_MAX(rdx, BC_NUM_RDX_VAL(a));
-	len = bc_vm_growSize(a->len, rdx);
-
-	BC_SIG_LOCK;
-
-	bc_num_init(&num1, len);
-	bc_num_init(&num2, len);
-	bc_num_setup(&half, half_digs, sizeof(half_digs) / sizeof(BcDig));
-
-	bc_num_one(&half);
-	half.num[0] = BC_BASE_POW / 2;
-	half.len = 1;
-	BC_NUM_RDX_SET_NP(half, 1);
-	half.scale = 1;
-
-	bc_num_init(&f, len);
-	bc_num_init(&fprime, len);
-
-	BC_SETJMP_LOCKED(err);
-
-	BC_SIG_UNLOCK;
-
-	x0 = &num1;
-	x1 = &num2;
-
-	bc_num_one(x0);
-	pow = bc_num_intDigits(a);
-
-	if (pow) {
-
-		if (pow & 1) x0->num[0] = 2;
-		else x0->num[0] = 6;
-
-		pow -= 2 - (pow & 1);
-		bc_num_shiftLeft(x0, pow / 2);
-	}
-
-	// I can set the rdx here directly because neg should be false.
-	x0->scale = x0->rdx = 0;
-	resscale = (scale + BC_BASE_DIGS) + 2;
-
-	while (bc_num_cmp(x1, x0)) {
-
-		assert(BC_NUM_NONZERO(x0));
-
-		bc_num_div(a, x0, &f, resscale);
-		bc_num_add(x0, &f, &fprime, resscale);
-
-		assert(BC_NUM_RDX_VALID_NP(fprime));
-		assert(BC_NUM_RDX_VALID_NP(half));
-
-		bc_num_mul(&fprime, &half, x1, resscale);
-
-		temp = x0;
-		x0 = x1;
-		x1 = temp;
-	}
+	// The answer has about half as many integer digits as a, plus scale.
+	len = BC_NUM_RDX(bc_vm_growSize(bc_num_intDigits(a) >> 1, scale));
 
-	bc_num_copy(b, x0);
-	if (b->scale > scale) bc_num_truncate(b, b->scale - scale);
+	if (len >= BC_NUM_SQRT_LEN) bc_num_sqrtFast(a, b, scale);
+	else bc_num_sqrtDiv(a, b, scale);
 
 	assert(!BC_NUM_NEG(b) || BC_NUM_NONZERO(b));
 	assert(BC_NUM_RDX_VALID(b));
 	assert(BC_NUM_RDX_VAL(b) <= b->len || !b->len);
 	assert(!b->len || b->num[b->len - 1] || BC_NUM_RDX_VAL(b) == b->len);
-
-err:
-	BC_SIG_MAYLOCK;
-	bc_num_free(&fprime);
-	bc_num_free(&f);
-	bc_num_free(&num2);
-	bc_num_free(&num1);
-	BC_LONGJMP_CONT;
 }
 
 void bc_num_divmod(BcNum *a, BcNum *b, BcNum *c, BcNum *d, size_t scale) {
@@ -2837,10 +5166,388 @@ err:
 }
 
 #if DC_ENABLED
+static void bc_num_barrett(BcNum *restrict a, BcNum *restrict m,
+                           BcNum *restrict mu, BcNum *restrict t,
+                           BcNum *restrict u)
+{
+	BcNum q;
+	size_t k = m->len;
+
+	assert(!BC_NUM_NEG(a) && !BC_NUM_RDX_VAL(a) && a->len <= 2 * k);
+
+	// This is Barrett reduction (Algorithm 14.42 in the Handbook of Applied
+	// Cryptography). It reduces a, which must be less than BC_BASE_POW^(2k), in
+	// place modulo m, where mu is floor(BC_BASE_POW^(2k) / m). The estimate of
+	// the quotient is at most two too small, so a few subtractions finish it.
+	bc_num_slice(a, k - 1, a->len, &q);
+	bc_num_mul(&q, mu, t, 0);
+	bc_num_slice(t, k + 1, t->len, &q);
+	bc_num_mul(&q, m, u, 0);
+
+	assert(u->len <= a->len);
+
+	if (BC_NUM_NONZERO(u)) {
+		bc_num_subArrays(a->num, u->num, u->len);
+		bc_num_clean(a);
+	}
+
+	while (bc_num_cmp(a, m) >= 0) {
+		bc_num_subArrays(a->num, m->num, m->len);
+		bc_num_clean(a);
+	}
+}
+
+static bool bc_num_expBit(const BcVec *restrict v, size_t i) {
+	BcBigDig chunk = *((BcBigDig*) bc_vec_item(v, i / BC_NUM_EXP_BITS));
+	return (chunk >> (i % BC_NUM_EXP_BITS)) & 1;
+}
+
+static size_t bc_num_expWindow(size_t bits) {
+
+	// These are the same break even points that OpenSSL uses. The number of
+	// odd powers to precompute doubles with each step.
+	if (bits > 671) return 6;
+	if (bits > 239) return 5;
+	if (bits > 79) return 4;
+	if (bits > 23) return 3;
+
+	return 1;
+}
+
+static size_t bc_num_expNext(const BcVec *restrict bits, size_t *i, size_t w,
+                             size_t *sqrs)
+{
+	size_t j, l;
+	BcBigDig val;
+
+	// This is one step of left-to-right sliding window exponentiation, starting
+	// at bit *i. A zero is squared away by itself, and any other window starts
+	// and ends with a one, so it is always an odd power. This returns the
+	// power to multiply by, or 0 for none, puts the number of squarings to do
+	// first in sqrs, and moves *i past the window.
+	if (!bc_num_expBit(bits, *i)) {
+		*i -= 1;
+		*sqrs = 1;
+		return 0;
+	}
+
+	j = *i >= w - 1 ? *i - (w - 1) : 0;
+
+	while (!bc_num_expBit(bits, j)) j += 1;
+
+	for (val = 0, l = *i + 1; l > j; --l)
+		val = (val << 1) | bc_num_expBit(bits, l - 1);
+
+	*sqrs = *i + 1 - j;
+	*i = j - 1;
+
+	return (size_t) val;
+}
+
+static void bc_num_expBarrett(BcNum *restrict base, BcNum *restrict m,
+                              const BcVec *restrict bits, size_t nbits,
+                              size_t w, BcNum *restrict d)
+{
+	BcNum mu, p, t, u, tbl[1 << (BC_NUM_EXP_WINDOW - 1)];
+	BcDig *tbl_digs;
+	size_t i, l, val, k = m->len, tk = BC_MAX(k, BC_NUM_DEF_SIZE);
+	bool started = false;
+
+	BC_SIG_LOCK;
+
+	bc_num_init(&mu, bc_vm_growSize(k, 2));
+	bc_num_init(&p, bc_vm_growSize(bc_vm_growSize(k, k), 1));
+	bc_num_init(&t, bc_vm_growSize(bc_vm_growSize(k, k), 3));
+	bc_num_init(&u, bc_vm_growSize(bc_vm_growSize(k, k), 3));
+
+	tbl_digs = bc_vm_malloc(bc_vm_arraySize(bc_vm_arraySize(tk, sizeof(BcDig)),
+	                                        (size_t) 1 << (w - 1)));
+
+	BC_SETJMP_LOCKED(err);
+
+	BC_SIG_UNLOCK;
+
+	// mu is floor(BC_BASE_POW^(2k) / m), which Barrett reduction needs.
+	bc_num_one(&t);
+	bc_num_shiftLeft(&t, 2 * k * BC_BASE_DIGS);
+	bc_num_div(&t, m, &mu, 0);
+
+	// The table holds the odd powers base^1, base^3, ..., base^(2^w - 1), all
+	// reduced, so they fit in k digits each, but bc_num_expand() never goes
+	// below BC_NUM_DEF_SIZE.
+	for (i = 0; i < ((size_t) 1) << (w - 1); ++i)
+		bc_num_setup(tbl + i, tbl_digs + i * tk, tk);
+
+	bc_num_copy(tbl, base);
+
+	if (w > 1) {
+
+		bc_num_sqr(base, &p, 0);
+		bc_num_barrett(&p, m, &mu, &t, &u);
+		bc_num_copy(base, &p);
+
+		for (i = 1; i < ((size_t) 1) << (w - 1); ++i) {
+			bc_num_mul(tbl + i - 1, base, &p, 0);
+			bc_num_barrett(&p, m, &mu, &t, &u);
+			bc_num_copy(tbl + i, &p);
+		}
+	}
+
+	for (i = nbits - 1; i < nbits;) {
+
+		val = bc_num_expNext(bits, &i, w, &l);
+
+		if (!started) {
+			assert(val);
+			bc_num_copy(d, tbl + (val >> 1));
+			started = true;
+			continue;
+		}
+
+		for (; l; --l) {
+			bc_num_sqr(d, &p, 0);
+			bc_num_barrett(&p, m, &mu, &t, &u);
+			bc_num_copy(d, &p);
+		}
+
+		if (val) {
+			bc_num_mul(d, tbl + (val >> 1), &p, 0);
+			bc_num_barrett(&p, m, &mu, &t, &u);
+			bc_num_copy(d, &p);
+		}
+	}
+
+err:
+	BC_SIG_MAYLOCK;
+	free(tbl_digs);
+	bc_num_free(&u);
+	bc_num_free(&t);
+	bc_num_free(&p);
+	bc_num_free(&mu);
+	BC_LONGJMP_CONT;
+}
+
+static size_t bc_num_toWords(const BcNum *restrict n, BcNumWord *restrict w) {
+
+	size_t i, j, len = 0;
+
+	// This converts n, which must be an integer, to binary words, least
+	// significant first, and returns how many there are. Every digit fits in
+	// a word, so w needs at most n->len words.
+	for (i = n->len - 1; i < n->len; --i) {
+
+		BcNumDWord carry = (BcNumDWord) n->num[i];
+
+		for (j = 0; j < len; ++j) {
+			carry += ((BcNumDWord) w[j]) * BC_BASE_POW;
+			w[j] = (BcNumWord) carry;
+			carry >>= BC_NUM_WORD_BITS;
+		}
+
+		if (carry) w[len++] = (BcNumWord) carry;
+	}
+
+	return len;
+}
+
+static void bc_num_fromWords(BcNumWord *restrict w, size_t len,
+                             BcNum *restrict n)
+{
+	size_t i;
+
+	// This is the reverse of bc_num_toWords(), and it destroys w. A word is
+	// never more than three digits.
+	bc_num_zero(n);
+	bc_num_expand(n, bc_vm_growSize(bc_vm_arraySize(len, 3), 1));
+
+	while (len && !w[len - 1]) len -= 1;
+
+	while (len) {
+
+		BcNumDWord rem = 0;
+
+		for (i = len - 1; i < len; --i) {
+			rem = (rem << BC_NUM_WORD_BITS) | w[i];
+			w[i] = (BcNumWord) (rem / BC_BASE_POW);
+			rem %= BC_BASE_POW;
+		}
+
+		n->num[n->len++] = (BcDig) rem;
+
+		while (len && !w[len - 1]) len -= 1;
+	}
+}
+
+static bool bc_num_wordsLess(const BcNumWord *restrict a,
+                             const BcNumWord *restrict b, size_t len)
+{
+	size_t i;
+	for (i = len - 1; i < len && a[i] == b[i]; --i);
+	return i < len && a[i] < b[i];
+}
+
+static void bc_num_wordsSub(BcNumWord *restrict a, const BcNumWord *restrict b,
+                            size_t len)
+{
+	size_t i;
+	BcNumDWord borrow = 0;
+
+	// This subtracts b from a modulo 2^(BC_NUM_WORD_BITS * len).
+	for (i = 0; i < len; ++i) {
+		BcNumDWord diff = ((BcNumDWord) a[i]) - b[i] - borrow;
+		a[i] = (BcNumWord) diff;
+		borrow = (diff >> BC_NUM_WORD_BITS) & 1;
+	}
+}
+
+static void bc_num_montMul(BcNumWord *r, const BcNumWord *a, const BcNumWord *b,
+                           const BcNumWord *restrict m, BcNumWord minv,
+                           BcNumWord *restrict t, size_t n)
+{
+	size_t i, j;
+	BcNumDWord carry;
+
+	// This is Montgomery multiplication (the CIOS method in Koc, Acar and
+	// Kaliski's "Analyzing and Comparing Montgomery Multiplication
+	// Algorithms"). It puts a * b / 2^(wn) mod m in r, where w is
+	// BC_NUM_WORD_BITS, a and b are less than m, which must be odd, and minv
+	// is -1/m mod 2^w. t must have room for n + 2 words.
+	memset(t, 0, (n + 2) * sizeof(BcNumWord));
+
+	for (i = 0; i < n; ++i) {
+
+		BcNumWord q;
+
+		for (carry = 0, j = 0; j < n; ++j) {
+			carry += ((BcNumDWord) a[j]) * b[i] + t[j];
+			t[j] = (BcNumWord) carry;
+			carry >>= BC_NUM_WORD_BITS;
+		}
+
+		carry += t[n];
+		t[n] = (BcNumWord) carry;
+		t[n + 1] = (BcNumWord) (carry >> BC_NUM_WORD_BITS);
+
+		q = t[0] * minv;
+		carry = (((BcNumDWord) q) * m[0] + t[0]) >> BC_NUM_WORD_BITS;
+
+		for (j = 1; j < n; ++j) {
+			carry += ((BcNumDWord) q) * m[j] + t[j];
+			t[j - 1] = (BcNumWord) carry;
+			carry >>= BC_NUM_WORD_BITS;
+		}
+
+		carry += t[n];
+		t[n - 1] = (BcNumWord) carry;
+		t[n] = t[n + 1] + (BcNumWord) (carry >> BC_NUM_WORD_BITS);
+	}
+
+	if (t[n] || !bc_num_wordsLess(t, m, n)) bc_num_wordsSub(t, m, n);
+
+	memcpy(r, t, n * sizeof(BcNumWord));
+}
+
+static void bc_num_expMont(BcNum *restrict base, BcNum *restrict m,
+                           const BcVec *restrict bits, size_t nbits, size_t w,
+                           BcNum *restrict d)
+{
+	BcNumWord *words, *mw, *x, *t, *tbl, minv;
+	size_t i, l, val, n, k = m->len;
+	bool started = false;
+
+	BC_SIG_LOCK;
+
+	// There are k words each for m, x, and the table entries, and k + 2 for
+	// t, though they might need fewer.
+	words = bc_vm_malloc(bc_vm_arraySize(bc_vm_growSize(bc_vm_arraySize(k,
+	                     ((size_t) 1 << (w - 1)) + 3), 2), sizeof(BcNumWord)));
+
+	BC_SETJMP_LOCKED(err);
+
+	BC_SIG_UNLOCK;
+
+	// Odd moduli are done in binary with Montgomery multiplication instead,
+	// which never has to carry in decimal. The only decimal conversions are
+	// for the base, the modulus, and the answer.
+	mw = words;
+	n = bc_num_toWords(m, mw);
+	x = mw + n;
+	t = x + n;
+	tbl = t + n + 2;
+
+	assert(n && (mw[0] & 1));
+
+	// This finds -1/m mod 2^w with Newton's Method, which doubles the number
+	// of correct bits each time, and m is its own inverse mod 2^3.
+	for (minv = mw[0], i = 3; i < BC_NUM_WORD_BITS; i *= 2)
+		minv *= 2 - mw[0] * minv;
+	minv = -minv;
+
+	// The base goes into Montgomery form, base * 2^(wn) mod m, where w is
+	// BC_NUM_WORD_BITS, by doubling it wn times.
+	memset(x, 0, n * sizeof(BcNumWord));
+	l = bc_num_toWords(base, x);
+	assert(l <= n);
+
+	for (i = 0; i < BC_NUM_WORD_BITS * n; ++i) {
+
+		BcNumWord top = x[n - 1] >> (BC_NUM_WORD_BITS - 1);
+
+		for (l = n - 1; l > 0; --l)
+			x[l] = (x[l] << 1) | (x[l - 1] >> (BC_NUM_WORD_BITS - 1));
+		x[0] <<= 1;
+
+		if (top || !bc_num_wordsLess(x, mw, n)) bc_num_wordsSub(x, mw, n);
+	}
+
+	// The table is the same as in bc_num_expBarrett().
+	memcpy(tbl, x, n * sizeof(BcNumWord));
+
+	if (w > 1) {
+
+		bc_num_montMul(x, x, x, mw, minv, t, n);
+
+		for (i = 1; i < ((size_t) 1) << (w - 1); ++i)
+			bc_num_montMul(tbl + i * n, tbl + (i - 1) * n, x, mw, minv, t, n);
+	}
+
+	for (i = nbits - 1; i < nbits;) {
+
+		val = bc_num_expNext(bits, &i, w, &l);
+
+		if (!started) {
+			assert(val);
+			memcpy(x, tbl + (val >> 1) * n, n * sizeof(BcNumWord));
+			started = true;
+			continue;
+		}
+
+		for (; l; --l) bc_num_montMul(x, x, x, mw, minv, t, n);
+
+		if (val)
+			bc_num_montMul(x, x, tbl + (val >> 1) * n, mw, minv, t, n);
+	}
+
+	// Multiplying by 1 takes it out of Montgomery form.
+	memset(tbl, 0, n * sizeof(BcNumWord));
+	tbl[0] = 1;
+	bc_num_montMul(x, x, tbl, mw, minv, t, n);
+
+	bc_num_fromWords(x, n, d);
+
+err:
+	BC_SIG_MAYLOCK;
+	free(words);
+	BC_LONGJMP_CONT;
+}
+
 void bc_num_modexp(BcNum *a, BcNum *b, BcNum *c, BcNum *restrict d) {
 
-	BcNum base, exp, two, temp;
-	BcDig two_digs[2];
+	BcNum m, base, exp, t;
+	BcVec bits;
+	BcBigDig rem;
+	size_t nbits, w;
+	bool neg;
 
 	assert(a != NULL && b != NULL && c != NULL && d != NULL);
 	assert(a != d && b != d && c != d);
@@ -2851,53 +5558,58 @@ void bc_num_modexp(BcNum *a, BcNum *b, BcNum *c, BcNum *restrict d) {
 		bc_vm_err(BC_ERR_MATH_NON_INTEGER);
 
 	bc_num_expand(d, c->len);
+	bc_num_one(d);
+
+	if (BC_NUM_ZERO(b)) return;
+
+	// Everything is done on magnitudes. The remainders that this used to take
+	// at every step had the sign of a, which only survives squaring when the
+	// exponent is odd, so that is the only time the answer is negative.
+	neg = BC_NUM_NEG(a) && (b->num[0] & 1);
+
+	bc_num_slice(c, 0, c->len, &m);
+
+	// The window is picked from the number of decimal digits in b, which is
+	// close enough to the number of bits.
+	w = bc_num_expWindow(bc_num_intDigits(b) * 10 / 3);
 
 	BC_SIG_LOCK;
 
 	bc_num_init(&base, c->len);
-	bc_num_setup(&two, two_digs, sizeof(two_digs) / sizeof(BcDig));
-	bc_num_init(&temp, b->len + 1);
+	bc_num_init(&t, b->len);
 	bc_num_createCopy(&exp, b);
+	bc_vec_init(&bits, sizeof(BcBigDig), NULL);
 
 	BC_SETJMP_LOCKED(err);
 
 	BC_SIG_UNLOCK;
 
-	bc_num_one(&two);
-	two.num[0] = 2;
-	bc_num_one(d);
-
-	// We already checked for 0.
-	bc_num_rem(a, c, &base, 0);
-
+	// The exponent is read BC_NUM_EXP_BITS bits at a time into bits, so each
+	// bit can be looked at directly instead of dividing by two every step.
 	while (BC_NUM_NONZERO(&exp)) {
+		bc_num_divArray(&exp, (BcBigDig) 1 << BC_NUM_EXP_BITS, &t, &rem);
+		bc_num_copy(&exp, &t);
+		bc_vec_push(&bits, &rem);
+	}
 
-		// Num two cannot be 0, so no errors.
-		bc_num_divmod(&exp, &two, &exp, &temp, 0);
-
-		if (BC_NUM_ONE(&temp) && !BC_NUM_NEG_NP(temp)) {
-
-			assert(BC_NUM_RDX_VALID(d));
-			assert(BC_NUM_RDX_VALID_NP(base));
-
-			bc_num_mul(d, &base, &temp, 0);
-
-			// We already checked for 0.
-			bc_num_rem(&temp, c, d, 0);
-		}
+	nbits = (bits.len - 1) * BC_NUM_EXP_BITS;
+	for (; rem; rem >>= 1) nbits += 1;
 
-		assert(BC_NUM_RDX_VALID_NP(base));
+	// We already checked for 0.
+	bc_num_rem(a, c, &base, 0);
+	BC_NUM_NEG_CLR_NP(base);
 
-		bc_num_mul(&base, &base, &temp, 0);
+	// BC_BASE_POW is even, so the lowest digit has the same parity as m.
+	if (m.num[0] & 1) bc_num_expMont(&base, &m, &bits, nbits, w, d);
+	else bc_num_expBarrett(&base, &m, &bits, nbits, w, d);
 
-		// We already checked for 0.
-		bc_num_rem(&temp, c, &base, 0);
-	}
+	if (neg && BC_NUM_NONZERO(d)) BC_NUM_NEG_TGL(d);
 
 err:
 	BC_SIG_MAYLOCK;
+	bc_vec_free(&bits);
 	bc_num_free(&exp);
-	bc_num_free(&temp);
+	bc_num_free(&t);
 	bc_num_free(&base);
 	BC_LONGJMP_CONT;
 	assert(!BC_NUM_NEG(d) || d->len);
@@ -83,7 +83,7 @@ void bc_parse_addString(BcParse *p) {
 static void bc_parse_addNum(BcParse *p, const char *string) {
 
 	BcVec *consts = &p->func->consts;
-	size_t idx;
+	size_t idx, i;
 	BcConst c;
 
 	if (bc_parse_zero[0] == string[0] && bc_parse_zero[1] == string[1]) {
@@ -100,9 +100,12 @@ static void bc_parse_addNum(BcParse *p, const char *string) {
 	BC_SIG_LOCK;
 
 	c.val = bc_vm_strdup(string);
-	c.base = BC_NUM_BIGDIG_MAX;
 
-	bc_num_clear(&c.num);
+	for (i = 0; i < BC_CONST_BASES; ++i) {
+		c.base[i] = BC_NUM_BIGDIG_MAX;
+		bc_num_clear(&c.num[i]);
+	}
+
 	bc_vec_push(consts, &c);
 
 	bc_parse_update(p, BC_INST_NUM, idx);
@@ -162,6 +165,9 @@ void bc_parse_reset(BcParse *p) {
 		bc_vec_popAll(&p->exits);
 		bc_vec_popAll(&p->conds);
 		bc_vec_popAll(&p->ops);
+		bc_vec_popAll(&p->folds);
+		p->dead = 0;
+		p->loop = false;
 	}
 #endif // BC_ENABLED
 
@@ -183,6 +189,7 @@ void bc_parse_free(BcParse *p) {
 		bc_vec_free(&p->conds);
 		bc_vec_free(&p->ops);
 		bc_vec_free(&p->buf);
+		bc_vec_free(&p->folds);
 	}
 #endif // BC_ENABLED
 
@@ -207,6 +214,10 @@ void bc_parse_init(BcParse *p, BcProgram *prog, size_t func) {
 		bc_vec_init(&p->conds, sizeof(size_t), NULL);
 		bc_vec_init(&p->ops, sizeof(BcLexType), NULL);
 		bc_vec_init(&p->buf, sizeof(char), NULL);
+		bc_vec_init(&p->folds, sizeof(BcLoc), NULL);
+		p->fold_end = p->dead = p->dead_len = 0;
+		p->call = p->call_end = SIZE_MAX;
+		p->ibase = p->loop = false;
 	}
 #endif // BC_ENABLED
 
@@ -89,6 +89,339 @@ static size_t bc_program_index(const char *restrict code, size_t *restrict bgn)
 	return res;
 }
 
+static size_t bc_program_operands(uchar inst) {
+
+	// This returns how many indices follow inst in the code.
+	switch (inst) {
+
+#if BC_ENABLED
+		case BC_INST_JUMP:
+		case BC_INST_JUMP_ZERO:
+		case BC_INST_ARRAY:
+		case BC_INST_OP_ASSIGN:
+#endif // BC_ENABLED
+#if DC_ENABLED
+		case BC_INST_LOAD:
+		case BC_INST_PUSH_VAR:
+		case BC_INST_PUSH_TO_VAR:
+#endif // DC_ENABLED
+		case BC_INST_NUM:
+		case BC_INST_VAR:
+		case BC_INST_ARRAY_ELEM:
+		case BC_INST_STR:
+		{
+			return 1;
+		}
+
+#if BC_ENABLED
+		case BC_INST_CALL:
+		case BC_INST_TAIL_CALL:
+		case BC_INST_JUMP_REL:
+		case BC_INST_EXPR:
+#endif // BC_ENABLED
+#if DC_ENABLED
+		case BC_INST_EXEC_COND:
+#endif // DC_ENABLED
+		{
+			return 2;
+		}
+
+#if BC_ENABLED
+		case BC_INST_EXPR_ASSIGN:
+		case BC_INST_EXPR_JUMP:
+		{
+			return 3;
+		}
+
+		case BC_INST_VAR_OP:
+		case BC_INST_VAR_OP_ASSIGN:
+		case BC_INST_ASSIGN_VAR:
+		{
+			return 4;
+		}
+#endif // BC_ENABLED
+
+		default:
+		{
+			return 0;
+		}
+	}
+}
+
+#if BC_ENABLED
+static size_t bc_program_fuse(const char *restrict code, size_t *restrict bgn,
+                              size_t len, const size_t *restrict lbls,
+                              size_t start, size_t *restrict insts)
+{
+	uchar in[4];
+	size_t ops[4], ends[4], n, i = *bgn, words = 0;
+	bool assign;
+
+	// This reads up to four instructions. It stops before any that a label
+	// points to because a jump there would land inside a fused instruction.
+	for (n = 0; n < 4 && i < len && (!n || !lbls[i - start]); ++n) {
+
+		in[n] = (uchar) code[i++];
+
+		if (bc_program_operands(in[n]) > 1) break;
+
+		ops[n] = bc_program_operands(in[n]) ? bc_program_index(code, &i) : 0;
+		ends[n] = i;
+	}
+
+	// A comparison and the jump on its result become one instruction that
+	// never pushes the result.
+	if (n >= 2 && BC_PROG_LOGICAL(in[0]) && in[1] == BC_INST_JUMP_ZERO) {
+		insts[words++] = BC_INST_JUMP_REL;
+		insts[words++] = in[0];
+		insts[words++] = ops[1];
+		*bgn = ends[1];
+	}
+	// A variable and a constant or variable that are only pushed to be
+	// operated on or assigned are read where they are instead.
+	else if (n >= 3 && in[0] == BC_INST_VAR && BC_PROG_SRC(in[1]) &&
+	         (BC_PROG_OP(in[2]) || BC_PROG_ASSIGN_NO_VAL(in[2])))
+	{
+		assign = (n == 4 && BC_PROG_OP(in[2]) &&
+		          in[3] == BC_INST_ASSIGN_NO_VAL);
+
+		if (!BC_PROG_OP(in[2])) insts[words++] = BC_INST_ASSIGN_VAR;
+		else if (assign) insts[words++] = BC_INST_VAR_OP_ASSIGN;
+		else insts[words++] = BC_INST_VAR_OP;
+
+		insts[words++] = ops[0];
+		insts[words++] = in[1];
+		insts[words++] = ops[1];
+		insts[words++] = in[2];
+		*bgn = ends[2 + assign];
+	}
+	// An operation whose result is only assigned gives it to the variable.
+	else if (n >= 2 && BC_PROG_OP(in[0]) && in[1] == BC_INST_ASSIGN_NO_VAL) {
+		insts[words++] = BC_INST_OP_ASSIGN;
+		insts[words++] = in[0];
+		*bgn = ends[1];
+	}
+
+	return words;
+}
+#endif // BC_ENABLED
+
+#if BC_ENABLED && BC_PROG_REGS
+static size_t bc_program_compile(BcFunc *f, const char *restrict code,
+                                 size_t *restrict bgn, size_t len,
+                                 const size_t *restrict lbls, size_t start,
+                                 size_t *restrict insts)
+{
+	uchar inst, types[BC_PROG_REGS_DEPTH];
+	size_t vals[BC_PROG_REGS_DEPTH], i = *bgn, j, end = 0, nops = 0, n = 0;
+	size_t depth = 0, first = f->ir.len, words;
+	unsigned int live = 0;
+	BcRegOp op;
+
+	// This runs the code on types and values instead of numbers for as long as
+	// it only pushes variables and constants and operates on them. Every value
+	// that an operation makes goes in the lowest register that is not holding
+	// another value, so an operation never writes to one of its operands.
+	while (i < len && (i == *bgn || !lbls[i - start])) {
+
+		inst = (uchar) code[i];
+
+		if (BC_PROG_SRC(inst) && depth < BC_PROG_REGS_DEPTH) {
+
+			j = i + 1;
+
+			types[depth] = inst;
+			vals[depth] = bc_program_operands(inst) ?
+			              bc_program_index(code, &j) : 0;
+
+			depth += 1;
+			i = j;
+		}
+		else if ((BC_PROG_OP(inst) || BC_PROG_LOGICAL(inst)) && depth >= 2) {
+
+			op.inst = inst;
+			op.a_t = types[depth - 2];
+			op.a = vals[depth - 2];
+			op.b_t = types[depth - 1];
+			op.b = vals[depth - 1];
+
+			for (op.dst = 0; live & (1U << op.dst); ++op.dst);
+
+			if (op.a_t == BC_PROG_REG) live &= ~(1U << op.a);
+			if (op.b_t == BC_PROG_REG) live &= ~(1U << op.b);
+			live |= 1U << op.dst;
+
+			depth -= 1;
+			types[depth - 1] = BC_PROG_REG;
+			vals[depth - 1] = op.dst;
+
+			bc_vec_push(&f->ir, &op);
+			nops += 1;
+			i += 1;
+
+			// If the code stops here, the expression can be pushed.
+			if (depth == 1) {
+				end = i;
+				n = nops;
+			}
+		}
+		else break;
+	}
+
+	inst = (uchar) (i < len && !lbls[i - start] ? code[i] : BC_INST_INVALID);
+
+	// A single operation is left to bc_program_fuse(). Otherwise, the
+	// expression is best consumed by the jump or assignment after it, and if
+	// not, its value is pushed.
+	if (nops >= 2 && depth == 1 && inst == BC_INST_JUMP_ZERO) {
+		insts[0] = BC_INST_EXPR_JUMP;
+		i += 1;
+		insts[3] = bc_program_index(code, &i);
+		words = 4;
+	}
+	else if (nops >= 2 && depth == 2 && types[0] == BC_INST_VAR &&
+	         types[1] == BC_PROG_REG && inst == BC_INST_ASSIGN_NO_VAL)
+	{
+		insts[0] = BC_INST_EXPR_ASSIGN;
+		insts[3] = vals[0];
+		i += 1;
+		words = 4;
+	}
+	else if (n >= 2) {
+		insts[0] = BC_INST_EXPR;
+		nops = n;
+		i = end;
+		words = 3;
+	}
+	else {
+		bc_vec_npop(&f->ir, nops);
+		return 0;
+	}
+
+	bc_vec_npop(&f->ir, f->ir.len - first - nops);
+
+	insts[1] = first;
+	insts[2] = nops;
+	*bgn = i;
+
+	return words;
+}
+#endif // BC_ENABLED && BC_PROG_REGS
+
+static size_t* bc_program_decode(BcFunc *f) {
+
+	const char *code = f->code.v;
+	size_t i, j, n, w, first, start = f->decoded, len = f->code.len, *insts;
+	uchar inst;
+#if BC_ENABLED
+	BcVec map;
+	size_t *words;
+#endif // BC_ENABLED
+
+	if (start == len) return (size_t*) f->insts.v;
+
+	assert(start < len);
+
+	// This decodes the code that has been added since the last time, so that
+	// execution does not have to decode indices or look up labels. Code only
+	// ever grows at the end until it is cleared, so everything is allocated up
+	// front. An instruction takes no more words than it takes bytes, and a
+	// fused one takes at most one more word than the at least four bytes it
+	// replaces.
+#if BC_ENABLED
+	BC_SIG_LOCK;
+
+	bc_vec_init(&map, sizeof(size_t), NULL);
+
+	BC_SETJMP_LOCKED(err);
+
+	BC_SIG_UNLOCK;
+
+	bc_vec_expand(&map, bc_vm_growSize(len - start, 1));
+	words = (size_t*) map.v;
+
+	// Until an instruction is decoded, its entry says whether a label points
+	// to it.
+	memset(words, 0, (len - start + 1) * sizeof(size_t));
+
+	for (i = 0; BC_IS_BC && i < f->labels.len; ++i) {
+		size_t addr = *((size_t*) bc_vec_item(&f->labels, i));
+		if (addr >= start && addr <= len) words[addr - start] = 1;
+	}
+#endif // BC_ENABLED
+
+	first = f->insts.len;
+	n = len - start;
+
+	if (first + n + n / 4 > f->insts.cap) bc_vec_grow(&f->insts, n + n / 4);
+
+	insts = (size_t*) f->insts.v;
+
+	for (i = start, w = first; i < len;) {
+
+#if BC_ENABLED
+		words[i - start] = w;
+
+		if (BC_IS_BC) {
+
+#if BC_PROG_REGS
+			n = bc_program_compile(f, code, &i, len, words, start, insts + w);
+			if (!n) n = bc_program_fuse(code, &i, len, words, start, insts + w);
+#else // BC_PROG_REGS
+			n = bc_program_fuse(code, &i, len, words, start, insts + w);
+#endif // BC_PROG_REGS
+
+			w += n;
+
+			if (n) continue;
+		}
+#endif // BC_ENABLED
+
+		inst = (uchar) code[i];
+		insts[w++] = inst;
+		i += 1;
+
+		for (j = bc_program_operands(inst); j; --j)
+			insts[w++] = bc_program_index(code, &i);
+	}
+
+#if BC_ENABLED
+	words[len - start] = w;
+
+	// Jumps are turned from labels into the words that the labels are at. A
+	// function is parsed in full before it is run, and main is only run when
+	// no block is open, so a label is always in the same piece of code as the
+	// jumps to it.
+	for (i = first; i < w; i += 1 + bc_program_operands(inst)) {
+
+		inst = (uchar) insts[i];
+
+		if (inst == BC_INST_JUMP || inst == BC_INST_JUMP_ZERO ||
+		    inst == BC_INST_JUMP_REL || inst == BC_INST_EXPR_JUMP)
+		{
+			size_t *lbl = insts + i + bc_program_operands(inst);
+			size_t addr = *((size_t*) bc_vec_item(&f->labels, *lbl));
+
+			assert(addr == SIZE_MAX || (addr >= start && addr <= len));
+
+			*lbl = addr != SIZE_MAX ? words[addr - start] : SIZE_MAX;
+		}
+	}
+#endif // BC_ENABLED
+
+	f->insts.len = w;
+	f->decoded = len;
+
+#if BC_ENABLED
+err:
+	BC_SIG_MAYLOCK;
+	bc_vec_free(&map);
+	BC_LONGJMP_CONT;
+#endif // BC_ENABLED
+
+	return (size_t*) f->insts.v;
+}
+
 #if BC_ENABLED
 static void bc_program_prepGlobals(BcProgram *p) {
 
@@ -376,29 +709,67 @@ static BcResult* bc_program_prepResult(BcProgram *p) {
 	return bc_vec_top(&p->results);
 }
 
-static void bc_program_const(BcProgram *p, const char *code, size_t *bgn) {
+BcNum* bc_program_constVal(BcConst *c, BcBigDig base) {
 
-	BcResult *r = bc_program_prepResult(p);
-	BcConst *c = bc_vec_item(p->consts, bc_program_index(code, bgn));
-	BcBigDig base = BC_PROG_IBASE(p);
+	BcNum num;
+	size_t i;
+
+	assert(c->base[0] != BC_CONST_FOLDED);
+
+	for (i = 0; i < BC_CONST_BASES && c->base[i] != base; ++i);
+
+	// If the constant has not been parsed in this base, the least recently
+	// used slot is reparsed.
+	if (i == BC_CONST_BASES) {
 
-	if (c->base != base) {
+		i -= 1;
 
-		if (c->num.num == NULL) {
+		if (c->num[i].num == NULL) {
 			BC_SIG_LOCK;
-			bc_num_init(&c->num, BC_NUM_RDX(strlen(c->val)));
+			bc_num_init(&c->num[i], BC_NUM_RDX(strlen(c->val)));
 			BC_SIG_UNLOCK;
 		}
 
 		// bc_num_parse() should only do operations that cannot fail.
-		bc_num_parse(&c->num, c->val, base);
+		c->base[i] = BC_NUM_BIGDIG_MAX;
+		bc_num_parse(&c->num[i], c->val, base);
+		c->base[i] = base;
+	}
+
+	BC_SIG_LOCK;
 
-		c->base = base;
+	// Move the slot to the front.
+	if (i) {
+		memcpy(&num, &c->num[i], sizeof(BcNum));
+		memmove(c->num + 1, c->num, i * sizeof(BcNum));
+		memmove(c->base + 1, c->base, i * sizeof(BcBigDig));
+		memcpy(&c->num[0], &num, sizeof(BcNum));
+		c->base[0] = base;
 	}
 
+	BC_SIG_UNLOCK;
+
+	return &c->num[0];
+}
+
+static BcNum* bc_program_constNum(BcProgram *p, size_t idx) {
+
+	BcConst *c = bc_vec_item(p->consts, idx);
+
+	// A folded constant has the same value in every base.
+	if (c->base[0] == BC_CONST_FOLDED) return &c->num[0];
+
+	return bc_program_constVal(c, BC_PROG_IBASE(p));
+}
+
+static void bc_program_const(BcProgram *p, const size_t *code, size_t *bgn) {
+
+	BcResult *r = bc_program_prepResult(p);
+	BcNum *n = bc_program_constNum(p, code[(*bgn)++]);
+
 	BC_SIG_LOCK;
 
-	bc_num_createCopy(&r->d.n, &c->num);
+	bc_num_share(&r->d.n, n);
 
 	BC_SIG_UNLOCK;
 }
@@ -427,6 +798,47 @@ static void bc_program_op(BcProgram *p, uchar inst) {
 	bc_program_retire(p, 1, 2);
 }
 
+#if BC_ENABLED
+static BcNum* bc_program_source(BcProgram *p, uchar inst, size_t idx) {
+
+	// This returns the number that inst would push.
+	if (inst == BC_INST_NUM) return bc_program_constNum(p, idx);
+	else if (inst == BC_INST_VAR)
+		return bc_vec_top(bc_program_vec(p, idx, BC_TYPE_VAR));
+	else if (inst == BC_INST_ZERO) return &p->zero;
+
+	assert(inst == BC_INST_ONE);
+
+	return &p->one;
+}
+
+static void bc_program_varOp(BcProgram *p, const size_t *restrict code,
+                             size_t *restrict bgn)
+{
+	BcResult *res;
+	BcNum *n1, *n2;
+	size_t var = code[(*bgn)++], src = code[(*bgn)++], idx;
+
+	n2 = bc_program_source(p, (uchar) src, code[(*bgn)++]);
+	idx = code[(*bgn)++] - BC_INST_POWER;
+
+	res = bc_program_prepResult(p);
+
+	n1 = bc_vec_top(bc_program_vec(p, var, BC_TYPE_VAR));
+
+	BC_SIG_LOCK;
+
+	bc_num_init(&res->d.n, bc_program_opReqs[idx](n1, n2, BC_PROG_SCALE(p)));
+
+	BC_SIG_UNLOCK;
+
+	assert(BC_NUM_RDX_VALID(n1));
+	assert(BC_NUM_RDX_VALID(n2));
+
+	bc_program_ops[idx](n1, n2, &res->d.n, BC_PROG_SCALE(p));
+}
+#endif // BC_ENABLED
+
 static void bc_program_read(BcProgram *p) {
 
 	BcStatus s;
@@ -454,7 +866,7 @@ static void bc_program_read(BcProgram *p) {
 	BC_SIG_UNLOCK;
 
 	bc_lex_file(&parse.l, bc_program_stdin_name);
-	bc_vec_popAll(&f->code);
+	bc_func_clearCode(f);
 
 	if (BC_R) s = bc_read_line(&buf, "");
 	else s = bc_read_line(&buf, BC_IS_BC ? "read> " : "?> ");
@@ -593,7 +1005,12 @@ static void bc_program_print(BcProgram *p, uchar inst, size_t idx) {
 		assert(inst != BC_INST_PRINT_STR);
 		bc_num_print(n, BC_PROG_OBASE(p), !pop);
 #if BC_ENABLED
-		if (BC_IS_BC) bc_num_copy(&p->last, n);
+		if (BC_IS_BC && n != &p->last) {
+			BC_SIG_LOCK;
+			bc_num_free(&p->last);
+			bc_num_share(&p->last, n);
+			BC_SIG_UNLOCK;
+		}
 #endif // BC_ENABLED
 	}
 	else {
@@ -649,17 +1066,11 @@ static void bc_program_unary(BcProgram *p, uchar inst) {
 	bc_program_retire(p, 1, 1);
 }
 
-static void bc_program_logical(BcProgram *p, uchar inst) {
+bool bc_program_compare(uchar inst, BcNum *n1, BcNum *n2) {
 
-	BcResult *opd1, *opd2, *res;
-	BcNum *n1, *n2;
 	bool cond = 0;
 	ssize_t cmp;
 
-	res = bc_program_prepResult(p);
-
-	bc_program_binOpPrep(p, &opd1, &n1, &opd2, &n2, 1);
-
 	if (inst == BC_INST_BOOL_AND)
 		cond = (bc_num_cmpZero(n1) && bc_num_cmpZero(n2));
 	else if (inst == BC_INST_BOOL_OR)
@@ -714,6 +1125,24 @@ static void bc_program_logical(BcProgram *p, uchar inst) {
 		}
 	}
 
+	return cond;
+}
+
+static bool bc_program_cond(BcProgram *p, uchar inst, size_t idx) {
+
+	BcResult *opd1, *opd2;
+	BcNum *n1, *n2;
+
+	bc_program_binOpPrep(p, &opd1, &n1, &opd2, &n2, idx);
+
+	return bc_program_compare(inst, n1, n2);
+}
+
+static void bc_program_logical(BcProgram *p, uchar inst) {
+
+	BcResult *res = bc_program_prepResult(p);
+	bool cond = bc_program_cond(p, inst, 1);
+
 	BC_SIG_LOCK;
 
 	bc_num_init(&res->d.n, BC_NUM_DEF_SIZE);
@@ -793,7 +1222,7 @@ static void bc_program_copyToVar(BcProgram *p, size_t idx,
 
 	BC_SIG_LOCK;
 
-	if (var) bc_num_createCopy(&r.d.n, n);
+	if (var) bc_num_share(&r.d.n, n);
 	else {
 
 		BcVec *v = (BcVec*) n, *rv = &r.d.v;
@@ -879,7 +1308,14 @@ static void bc_program_assign(BcProgram *p, uchar inst) {
 	}
 #endif // DC_ENABLED
 
-	if (BC_INST_IS_ASSIGN(inst)) bc_num_copy(l, r);
+	if (BC_INST_IS_ASSIGN(inst)) {
+		if (l != r) {
+			BC_SIG_LOCK;
+			bc_num_free(l);
+			bc_num_share(l, r);
+			BC_SIG_UNLOCK;
+		}
+	}
 #if BC_ENABLED
 	else {
 
@@ -935,7 +1371,7 @@ static void bc_program_assign(BcProgram *p, uchar inst) {
 	BC_SIG_LOCK;
 
 	if (use_val) {
-		bc_num_createCopy(&res.d.n, l);
+		bc_num_share(&res.d.n, l);
 		res.t = BC_RESULT_TEMP;
 		bc_vec_npop(&p->results, 2);
 		bc_vec_push(&p->results, &res);
@@ -945,11 +1381,164 @@ static void bc_program_assign(BcProgram *p, uchar inst) {
 	BC_SIG_UNLOCK;
 }
 
-static void bc_program_pushVar(BcProgram *p, const char *restrict code,
+#if BC_ENABLED
+static void bc_program_assignTemp(BcProgram *p) {
+
+	BcResult *left = bc_vec_item_rev(&p->results, 1);
+	BcResult *right = bc_vec_top(&p->results);
+	BcNum *l;
+
+	assert(right->t == BC_RESULT_TEMP);
+
+	// Anything but a variable needs the checks in bc_program_assign().
+	if (left->t != BC_RESULT_VAR) {
+		bc_program_assign(p, BC_INST_ASSIGN_NO_VAL);
+		return;
+	}
+
+	l = bc_program_num(p, left);
+
+	BC_SIG_LOCK;
+
+	// The temporary is not used again, so its digits are moved, not shared.
+	bc_num_free(l);
+	memcpy(l, &right->d.n, sizeof(BcNum));
+	bc_num_clear(&right->d.n);
+	bc_vec_npop(&p->results, 2);
+
+	BC_SIG_UNLOCK;
+}
+
+static void bc_program_assignVar(BcProgram *p, const size_t *restrict code,
+                                 size_t *restrict bgn)
+{
+	BcNum *l, *r;
+	size_t var = code[(*bgn)++], src = code[(*bgn)++];
+	uchar inst;
+
+	r = bc_program_source(p, (uchar) src, code[(*bgn)++]);
+	inst = (uchar) code[(*bgn)++];
+
+	l = bc_vec_top(bc_program_vec(p, var, BC_TYPE_VAR));
+
+	if (inst == BC_INST_ASSIGN_NO_VAL) {
+		if (l != r) {
+			BC_SIG_LOCK;
+			bc_num_free(l);
+			bc_num_share(l, r);
+			BC_SIG_UNLOCK;
+		}
+	}
+	else {
+
+		assert(BC_NUM_RDX_VALID(l));
+		assert(BC_NUM_RDX_VALID(r));
+
+		inst -= BC_INST_ASSIGN_POWER_NO_VAL;
+		bc_program_ops[inst](l, r, l, BC_PROG_SCALE(p));
+	}
+}
+
+static BcNum* bc_program_regs(BcProgram *p, const BcFunc *f,
+                              const size_t *restrict code,
+                              size_t *restrict bgn)
+{
+	BcRegOp *op;
+	BcNum *a, *b, *c = NULL;
+	size_t i, first = code[(*bgn)++], nops = code[(*bgn)++];
+
+	// This runs the register code of an expression and returns the register
+	// that has its value.
+	for (i = first; i < first + nops; ++i) {
+
+		op = bc_vec_item(&f->ir, i);
+
+		if (op->dst >= p->regs.len) {
+
+			BcNum n;
+
+			BC_SIG_LOCK;
+
+			bc_num_clear(&n);
+			while (op->dst >= p->regs.len) bc_vec_push(&p->regs, &n);
+
+			BC_SIG_UNLOCK;
+		}
+
+		c = bc_vec_item(&p->regs, op->dst);
+
+		// Operations expect a number that is as fresh as from bc_num_init(),
+		// so the old value of the register has to be cleared out.
+		if (c->num == NULL) {
+			BC_SIG_LOCK;
+			bc_num_init(c, BC_NUM_DEF_SIZE);
+			BC_SIG_UNLOCK;
+		}
+		else bc_num_zero(c);
+
+		a = op->a_t == BC_PROG_REG ? bc_vec_item(&p->regs, op->a) :
+		                             bc_program_source(p, op->a_t, op->a);
+		b = op->b_t == BC_PROG_REG ? bc_vec_item(&p->regs, op->b) :
+		                             bc_program_source(p, op->b_t, op->b);
+
+		assert(BC_NUM_RDX_VALID(a));
+		assert(BC_NUM_RDX_VALID(b));
+
+		if (BC_PROG_OP(op->inst)) {
+			size_t idx = op->inst - BC_INST_POWER;
+			bc_program_ops[idx](a, b, c, BC_PROG_SCALE(p));
+		}
+		else if (bc_program_compare(op->inst, a, b)) bc_num_one(c);
+		else bc_num_zero(c);
+	}
+
+	assert(c != NULL);
+
+	return c;
+}
+
+static void bc_program_expr(BcProgram *p, const BcFunc *f,
+                            const size_t *restrict code, size_t *restrict bgn)
+{
+	BcResult *res = bc_program_prepResult(p);
+	BcNum *n = bc_program_regs(p, f, code, bgn);
+
+	// The value is moved out of its register, which gets new digits the next
+	// time that it is written.
+	BC_SIG_LOCK;
+
+	memcpy(&res->d.n, n, sizeof(BcNum));
+	bc_num_clear(n);
+
+	BC_SIG_UNLOCK;
+}
+
+static void bc_program_exprAssign(BcProgram *p, const BcFunc *f,
+                                  const size_t *restrict code,
+                                  size_t *restrict bgn)
+{
+	BcNum *l, *r, temp;
+
+	r = bc_program_regs(p, f, code, bgn);
+	l = bc_vec_top(bc_program_vec(p, code[(*bgn)++], BC_TYPE_VAR));
+
+	// The variable and the register trade digits, so the register reuses the
+	// old ones of the variable.
+	BC_SIG_LOCK;
+
+	memcpy(&temp, l, sizeof(BcNum));
+	memcpy(l, r, sizeof(BcNum));
+	memcpy(r, &temp, sizeof(BcNum));
+
+	BC_SIG_UNLOCK;
+}
+#endif // BC_ENABLED
+
+static void bc_program_pushVar(BcProgram *p, const size_t *restrict code,
                                size_t *restrict bgn, bool pop, bool copy)
 {
 	BcResult r;
-	size_t idx = bc_program_index(code, bgn);
+	size_t idx = code[(*bgn)++];
 
 	r.t = BC_RESULT_VAR;
 	r.d.loc.loc = idx;
@@ -969,7 +1558,7 @@ static void bc_program_pushVar(BcProgram *p, const char *restrict code,
 			BC_SIG_LOCK;
 
 			r.t = BC_RESULT_TEMP;
-			bc_num_createCopy(&r.d.n, num);
+			bc_num_share(&r.d.n, num);
 
 			if (!copy) bc_vec_pop(v);
 
@@ -991,14 +1580,14 @@ static void bc_program_pushVar(BcProgram *p, const char *restrict code,
 	bc_vec_push(&p->results, &r);
 }
 
-static void bc_program_pushArray(BcProgram *p, const char *restrict code,
+static void bc_program_pushArray(BcProgram *p, const size_t *restrict code,
                                  size_t *restrict bgn, uchar inst)
 {
 	BcResult r, *operand;
 	BcNum *num;
 	BcBigDig temp;
 
-	r.d.loc.loc = bc_program_index(code, bgn);
+	r.d.loc.loc = code[(*bgn)++];
 
 #if BC_ENABLED
 	if (inst == BC_INST_ARRAY) {
@@ -1025,49 +1614,99 @@ static void bc_program_pushArray(BcProgram *p, const char *restrict code,
 #if BC_ENABLED
 static void bc_program_incdec(BcProgram *p, uchar inst) {
 
-	BcResult *ptr, res, copy;
+	BcResult *ptr, res;
 	BcNum *num;
 	uchar inst2;
 
 	bc_program_prep(p, &ptr, &num, 0);
 
-	BC_SIG_LOCK;
-
-	copy.t = BC_RESULT_TEMP;
-	bc_num_createCopy(&copy.d.n, num);
-
-	BC_SETJMP_LOCKED(exit);
-
-	BC_SIG_UNLOCK;
-
 	res.t = BC_RESULT_ONE;
 	inst2 = BC_INST_ASSIGN_PLUS + (inst & 0x01);
 
 	bc_vec_push(&p->results, &res);
 	bc_program_assign(p, inst2);
 
-	BC_SIG_LOCK;
+	// The old value is only taken from the new one, after the assignment. A
+	// copy taken before would share the digits and stop them from being
+	// changed in place. Adding or subtracting one does not change the scale,
+	// so undoing it is exact, and it unshares the result from the variable.
+	ptr = bc_vec_top(&p->results);
 
-	bc_vec_pop(&p->results);
-	bc_vec_push(&p->results, &copy);
+	if (inst2 == BC_INST_ASSIGN_PLUS)
+		bc_num_sub(&ptr->d.n, &p->one, &ptr->d.n, 0);
+	else bc_num_add(&ptr->d.n, &p->one, &ptr->d.n, 0);
+}
 
-	BC_UNSETJMP;
+// Gets the function that is running out of the way of a call to f, whose value
+// it is about to return, so that f can reuse its place on the stacks. This is
+// not done if any argument is an array, which could be one of its autos, if f
+// is void, which should make the return an error, or if the function has other
+// results on the stack. Because bc is dynamically scoped, it is also not done
+// unless f has every param and auto of the function, since f could see them
+// otherwise. Returns whether it did.
+static bool bc_program_tail(BcProgram *p, const BcFunc *f, size_t nparams) {
 
-	BC_SIG_UNLOCK;
+	BcInstPtr *ip = bc_vec_top(&p->stack);
+	BcFunc *cur = bc_vec_item(&p->fns, ip->func);
+	size_t i, j;
 
-	return;
+	assert(BC_PROG_STACK(&p->stack, 2));
 
-exit:
-	BC_SIG_MAYLOCK;
-	bc_num_free(&copy.d.n);
-	BC_LONGJMP_CONT;
+	if (f->voidfn || p->results.len != ip->len + nparams) return false;
+
+	for (i = 0; i < cur->autos.len; ++i) {
+
+		BcLoc *a = bc_vec_item(&cur->autos, i);
+
+		for (j = 0; j < f->autos.len; ++j) {
+			BcLoc *b = bc_vec_item(&f->autos, j);
+			if (a->loc == b->loc && a->idx == b->idx) break;
+		}
+
+		if (j == f->autos.len) return false;
+	}
+
+	for (i = 0; i < nparams; ++i) {
+		BcResult *arg = bc_vec_item_rev(&p->results, i);
+		if (arg->t == BC_RESULT_ARRAY || arg->t == BC_RESULT_VOID)
+			return false;
+	}
+
+	// Arguments that are variables or array elements need their values now,
+	// since they could be autos that are about to be popped.
+	for (i = 0; i < nparams; ++i) {
+
+		BcResult *arg = bc_vec_item_rev(&p->results, i);
+		BcNum *n, num;
+
+		if (arg->t != BC_RESULT_VAR && arg->t != BC_RESULT_ARRAY_ELEM) continue;
+
+		n = bc_program_num(p, arg);
+
+		BC_SIG_LOCK;
+
+		bc_num_share(&num, n);
+		arg->t = BC_RESULT_TEMP;
+		memcpy(&arg->d.n, &num, sizeof(BcNum));
+
+		BC_SIG_UNLOCK;
+	}
+
+	for (i = 0; i < cur->autos.len; ++i) {
+		BcLoc *a = bc_vec_item(&cur->autos, i);
+		bc_vec_pop(bc_program_vec(p, a->loc, (BcType) a->idx));
+	}
+
+	bc_vec_pop(&p->stack);
+
+	return true;
 }
 
-static void bc_program_call(BcProgram *p, const char *restrict code,
-                            size_t *restrict idx)
+static void bc_program_call(BcProgram *p, const size_t *restrict code,
+                            size_t *restrict idx, bool tail)
 {
 	BcInstPtr ip;
-	size_t i, nparams = bc_program_index(code, idx);
+	size_t i, nparams = code[(*idx)++];
 	BcFunc *f;
 	BcVec *v;
 	BcLoc *a;
@@ -1075,7 +1714,7 @@ static void bc_program_call(BcProgram *p, const char *restrict code,
 	BcResult *arg;
 
 	ip.idx = 0;
-	ip.func = bc_program_index(code, idx);
+	ip.func = code[(*idx)++];
 	f = bc_vec_item(&p->fns, ip.func);
 
 	if (BC_ERR(!f->code.len)) bc_vm_verr(BC_ERR_EXEC_UNDEF_FUNC, f->name);
@@ -1085,7 +1724,10 @@ static void bc_program_call(BcProgram *p, const char *restrict code,
 
 	assert(BC_PROG_STACK(&p->results, nparams));
 
-	if (BC_G) bc_program_prepGlobals(p);
+	// A tail call keeps the globals of the function that it replaces.
+	if (tail) tail = bc_program_tail(p, f, nparams);
+
+	if (BC_G && !tail) bc_program_prepGlobals(p);
 
 	for (i = 0; i < nparams; ++i) {
 
@@ -1155,7 +1797,7 @@ static void bc_program_return(BcProgram *p, uchar inst) {
 
 		BC_SIG_LOCK;
 
-		bc_num_createCopy(&res->d.n, num);
+		bc_num_share(&res->d.n, num);
 	}
 	else if (inst == BC_INST_RET_VOID) res->t = BC_RESULT_VOID;
 	else {
@@ -1218,7 +1860,7 @@ static void bc_program_builtin(BcProgram *p, uchar inst) {
 
 		BC_SIG_LOCK;
 
-		bc_num_createCopy(&res->d.n, num);
+		bc_num_share(&res->d.n, num);
 
 		BC_SIG_UNLOCK;
 
@@ -1481,7 +2123,7 @@ static void bc_program_nquit(BcProgram *p, uchar inst) {
 	}
 }
 
-static void bc_program_execStr(BcProgram *p, const char *restrict code,
+static void bc_program_execStr(BcProgram *p, const size_t *restrict code,
                                    size_t *restrict bgn, bool cond, size_t len)
 {
 	BcResult *r;
@@ -1505,8 +2147,8 @@ static void bc_program_execStr(BcProgram *p, const char *restrict code,
 		bool exec;
 		size_t idx, then_idx, else_idx;
 
-		then_idx = bc_program_index(code, bgn);
-		else_idx = bc_program_index(code, bgn);
+		then_idx = code[(*bgn)++];
+		else_idx = code[(*bgn)++];
 
 		exec = (r->d.n.len != 0);
 
@@ -1590,7 +2232,7 @@ err:
 	BC_SIG_MAYLOCK;
 	bc_parse_free(&prs);
 	f = bc_vec_item(&p->fns, fidx);
-	bc_vec_popAll(&f->code);
+	bc_func_clearCode(f);
 exit:
 	bc_vec_pop(&p->results);
 	BC_LONGJMP_CONT;
@@ -1706,7 +2348,10 @@ void bc_program_free(BcProgram *p) {
 	bc_vec_free(&p->stack);
 
 #if BC_ENABLED
-	if (BC_IS_BC) bc_num_free(&p->last);
+	if (BC_IS_BC) {
+		bc_num_free(&p->last);
+		bc_vec_free(&p->regs);
+	}
 #endif // BC_ENABLED
 
 #if BC_ENABLE_EXTRA_MATH && BC_ENABLE_RAND
@@ -1768,7 +2413,10 @@ void bc_program_init(BcProgram *p) {
 	bc_num_one(&p->one);
 
 #if BC_ENABLED
-	if (BC_IS_BC) bc_num_init(&p->last, BC_NUM_DEF_SIZE);
+	if (BC_IS_BC) {
+		bc_num_init(&p->last, BC_NUM_DEF_SIZE);
+		bc_vec_init(&p->regs, sizeof(BcNum), bc_num_free);
+	}
 #endif // BC_ENABLED
 
 	bc_vec_init(&p->fns, sizeof(BcFunc), bc_func_free);
@@ -1806,7 +2454,7 @@ void bc_program_reset(BcProgram *p) {
 #endif // BC_ENABLED
 
 	f = bc_vec_item(&p->fns, BC_PROG_MAIN);
-	bc_vec_npop(&f->code, f->code.len);
+	bc_func_clearCode(f);
 	ip = bc_vec_top(&p->stack);
 	bc_program_setVecs(p, f);
 	memset(ip, 0, sizeof(BcInstPtr));
@@ -1825,7 +2473,8 @@ void bc_program_exec(BcProgram *p) {
 	BcResult r, *ptr;
 	BcInstPtr *ip = bc_vec_top(&p->stack);
 	BcFunc *func = (BcFunc*) bc_vec_item(&p->fns, ip->func);
-	char *code = func->code.v;
+	size_t *code = bc_program_decode(func);
+	uchar inst;
 	bool cond = false;
 #if BC_ENABLED
 	BcNum *num;
@@ -1838,101 +2487,314 @@ void bc_program_exec(BcProgram *p) {
 	jmp_bufs_len = vm.jmp_bufs.len;
 #endif // NDEBUG
 
+#if BC_PROG_THREADED
+	// This has to have every instruction in it.
+	static const void* const bc_program_lbls[] = {
+#if BC_ENABLED
+		[BC_INST_INC] = BC_PROG_LBL(BC_INST_INC),
+		[BC_INST_DEC] = BC_PROG_LBL(BC_INST_DEC),
+#endif // BC_ENABLED
+		[BC_INST_NEG] = BC_PROG_LBL(BC_INST_NEG),
+		[BC_INST_BOOL_NOT] = BC_PROG_LBL(BC_INST_BOOL_NOT),
+#if BC_ENABLE_EXTRA_MATH
+		[BC_INST_TRUNC] = BC_PROG_LBL(BC_INST_TRUNC),
+#endif // BC_ENABLE_EXTRA_MATH
+		[BC_INST_POWER] = BC_PROG_LBL(BC_INST_POWER),
+		[BC_INST_MULTIPLY] = BC_PROG_LBL(BC_INST_MULTIPLY),
+		[BC_INST_DIVIDE] = BC_PROG_LBL(BC_INST_DIVIDE),
+		[BC_INST_MODULUS] = BC_PROG_LBL(BC_INST_MODULUS),
+		[BC_INST_PLUS] = BC_PROG_LBL(BC_INST_PLUS),
+		[BC_INST_MINUS] = BC_PROG_LBL(BC_INST_MINUS),
+#if BC_ENABLE_EXTRA_MATH
+		[BC_INST_PLACES] = BC_PROG_LBL(BC_INST_PLACES),
+		[BC_INST_LSHIFT] = BC_PROG_LBL(BC_INST_LSHIFT),
+		[BC_INST_RSHIFT] = BC_PROG_LBL(BC_INST_RSHIFT),
+#endif // BC_ENABLE_EXTRA_MATH
+		[BC_INST_REL_EQ] = BC_PROG_LBL(BC_INST_REL_EQ),
+		[BC_INST_REL_LE] = BC_PROG_LBL(BC_INST_REL_LE),
+		[BC_INST_REL_GE] = BC_PROG_LBL(BC_INST_REL_GE),
+		[BC_INST_REL_NE] = BC_PROG_LBL(BC_INST_REL_NE),
+		[BC_INST_REL_LT] = BC_PROG_LBL(BC_INST_REL_LT),
+		[BC_INST_REL_GT] = BC_PROG_LBL(BC_INST_REL_GT),
+		[BC_INST_BOOL_OR] = BC_PROG_LBL(BC_INST_BOOL_OR),
+		[BC_INST_BOOL_AND] = BC_PROG_LBL(BC_INST_BOOL_AND),
+#if BC_ENABLED
+		[BC_INST_ASSIGN_POWER] = BC_PROG_LBL(BC_INST_ASSIGN_POWER),
+		[BC_INST_ASSIGN_MULTIPLY] = BC_PROG_LBL(BC_INST_ASSIGN_MULTIPLY),
+		[BC_INST_ASSIGN_DIVIDE] = BC_PROG_LBL(BC_INST_ASSIGN_DIVIDE),
+		[BC_INST_ASSIGN_MODULUS] = BC_PROG_LBL(BC_INST_ASSIGN_MODULUS),
+		[BC_INST_ASSIGN_PLUS] = BC_PROG_LBL(BC_INST_ASSIGN_PLUS),
+		[BC_INST_ASSIGN_MINUS] = BC_PROG_LBL(BC_INST_ASSIGN_MINUS),
+#if BC_ENABLE_EXTRA_MATH
+		[BC_INST_ASSIGN_PLACES] = BC_PROG_LBL(BC_INST_ASSIGN_PLACES),
+		[BC_INST_ASSIGN_LSHIFT] = BC_PROG_LBL(BC_INST_ASSIGN_LSHIFT),
+		[BC_INST_ASSIGN_RSHIFT] = BC_PROG_LBL(BC_INST_ASSIGN_RSHIFT),
+#endif // BC_ENABLE_EXTRA_MATH
+		[BC_INST_ASSIGN] = BC_PROG_LBL(BC_INST_ASSIGN),
+		[BC_INST_ASSIGN_POWER_NO_VAL] =
+			BC_PROG_LBL(BC_INST_ASSIGN_POWER_NO_VAL),
+		[BC_INST_ASSIGN_MULTIPLY_NO_VAL] =
+			BC_PROG_LBL(BC_INST_ASSIGN_MULTIPLY_NO_VAL),
+		[BC_INST_ASSIGN_DIVIDE_NO_VAL] =
+			BC_PROG_LBL(BC_INST_ASSIGN_DIVIDE_NO_VAL),
+		[BC_INST_ASSIGN_MODULUS_NO_VAL] =
+			BC_PROG_LBL(BC_INST_ASSIGN_MODULUS_NO_VAL),
+		[BC_INST_ASSIGN_PLUS_NO_VAL] = BC_PROG_LBL(BC_INST_ASSIGN_PLUS_NO_VAL),
+		[BC_INST_ASSIGN_MINUS_NO_VAL] =
+			BC_PROG_LBL(BC_INST_ASSIGN_MINUS_NO_VAL),
+#if BC_ENABLE_EXTRA_MATH
+		[BC_INST_ASSIGN_PLACES_NO_VAL] =
+			BC_PROG_LBL(BC_INST_ASSIGN_PLACES_NO_VAL),
+		[BC_INST_ASSIGN_LSHIFT_NO_VAL] =
+			BC_PROG_LBL(BC_INST_ASSIGN_LSHIFT_NO_VAL),
+		[BC_INST_ASSIGN_RSHIFT_NO_VAL] =
+			BC_PROG_LBL(BC_INST_ASSIGN_RSHIFT_NO_VAL),
+#endif // BC_ENABLE_EXTRA_MATH
+#endif // BC_ENABLED
+		[BC_INST_ASSIGN_NO_VAL] = BC_PROG_LBL(BC_INST_ASSIGN_NO_VAL),
+		[BC_INST_NUM] = BC_PROG_LBL(BC_INST_NUM),
+		[BC_INST_VAR] = BC_PROG_LBL(BC_INST_VAR),
+		[BC_INST_ARRAY_ELEM] = BC_PROG_LBL(BC_INST_ARRAY_ELEM),
+#if BC_ENABLED
+		[BC_INST_ARRAY] = BC_PROG_LBL(BC_INST_ARRAY),
+#endif // BC_ENABLED
+		[BC_INST_ZERO] = BC_PROG_LBL(BC_INST_ZERO),
+		[BC_INST_ONE] = BC_PROG_LBL(BC_INST_ONE),
+#if BC_ENABLED
+		[BC_INST_LAST] = BC_PROG_LBL(BC_INST_LAST),
+#endif // BC_ENABLED
+		[BC_INST_IBASE] = BC_PROG_LBL(BC_INST_IBASE),
+		[BC_INST_OBASE] = BC_PROG_LBL(BC_INST_OBASE),
+		[BC_INST_SCALE] = BC_PROG_LBL(BC_INST_SCALE),
+#if BC_ENABLE_EXTRA_MATH && BC_ENABLE_RAND
+		[BC_INST_SEED] = BC_PROG_LBL(BC_INST_SEED),
+#endif // BC_ENABLE_EXTRA_MATH && BC_ENABLE_RAND
+		[BC_INST_LENGTH] = BC_PROG_LBL(BC_INST_LENGTH),
+		[BC_INST_SCALE_FUNC] = BC_PROG_LBL(BC_INST_SCALE_FUNC),
+		[BC_INST_SQRT] = BC_PROG_LBL(BC_INST_SQRT),
+		[BC_INST_ABS] = BC_PROG_LBL(BC_INST_ABS),
+#if BC_ENABLE_EXTRA_MATH && BC_ENABLE_RAND
+		[BC_INST_IRAND] = BC_PROG_LBL(BC_INST_IRAND),
+#endif // BC_ENABLE_EXTRA_MATH && BC_ENABLE_RAND
+		[BC_INST_READ] = BC_PROG_LBL(BC_INST_READ),
+#if BC_ENABLE_EXTRA_MATH && BC_ENABLE_RAND
+		[BC_INST_RAND] = BC_PROG_LBL(BC_INST_RAND),
+#endif // BC_ENABLE_EXTRA_MATH && BC_ENABLE_RAND
+		[BC_INST_MAXIBASE] = BC_PROG_LBL(BC_INST_MAXIBASE),
+		[BC_INST_MAXOBASE] = BC_PROG_LBL(BC_INST_MAXOBASE),
+		[BC_INST_MAXSCALE] = BC_PROG_LBL(BC_INST_MAXSCALE),
+#if BC_ENABLE_EXTRA_MATH && BC_ENABLE_RAND
+		[BC_INST_MAXRAND] = BC_PROG_LBL(BC_INST_MAXRAND),
+#endif // BC_ENABLE_EXTRA_MATH && BC_ENABLE_RAND
+		[BC_INST_PRINT] = BC_PROG_LBL(BC_INST_PRINT),
+		[BC_INST_PRINT_POP] = BC_PROG_LBL(BC_INST_PRINT_POP),
+		[BC_INST_STR] = BC_PROG_LBL(BC_INST_STR),
+		[BC_INST_PRINT_STR] = BC_PROG_LBL(BC_INST_PRINT_STR),
+#if BC_ENABLED
+		[BC_INST_JUMP] = BC_PROG_LBL(BC_INST_JUMP),
+		[BC_INST_JUMP_ZERO] = BC_PROG_LBL(BC_INST_JUMP_ZERO),
+		[BC_INST_CALL] = BC_PROG_LBL(BC_INST_CALL),
+		[BC_INST_TAIL_CALL] = BC_PROG_LBL(BC_INST_TAIL_CALL),
+		[BC_INST_RET] = BC_PROG_LBL(BC_INST_RET),
+		[BC_INST_RET0] = BC_PROG_LBL(BC_INST_RET0),
+		[BC_INST_RET_VOID] = BC_PROG_LBL(BC_INST_RET_VOID),
+		[BC_INST_HALT] = BC_PROG_LBL(BC_INST_HALT),
+#endif // BC_ENABLED
+		[BC_INST_POP] = BC_PROG_LBL(BC_INST_POP),
+#if DC_ENABLED
+		[BC_INST_POP_EXEC] = BC_PROG_LBL(BC_INST_POP_EXEC),
+		[BC_INST_MODEXP] = BC_PROG_LBL(BC_INST_MODEXP),
+		[BC_INST_DIVMOD] = BC_PROG_LBL(BC_INST_DIVMOD),
+		[BC_INST_EXECUTE] = BC_PROG_LBL(BC_INST_EXECUTE),
+		[BC_INST_EXEC_COND] = BC_PROG_LBL(BC_INST_EXEC_COND),
+		[BC_INST_ASCIIFY] = BC_PROG_LBL(BC_INST_ASCIIFY),
+		[BC_INST_PRINT_STREAM] = BC_PROG_LBL(BC_INST_PRINT_STREAM),
+		[BC_INST_PRINT_STACK] = BC_PROG_LBL(BC_INST_PRINT_STACK),
+		[BC_INST_CLEAR_STACK] = BC_PROG_LBL(BC_INST_CLEAR_STACK),
+		[BC_INST_STACK_LEN] = BC_PROG_LBL(BC_INST_STACK_LEN),
+		[BC_INST_DUPLICATE] = BC_PROG_LBL(BC_INST_DUPLICATE),
+		[BC_INST_SWAP] = BC_PROG_LBL(BC_INST_SWAP),
+		[BC_INST_LOAD] = BC_PROG_LBL(BC_INST_LOAD),
+		[BC_INST_PUSH_VAR] = BC_PROG_LBL(BC_INST_PUSH_VAR),
+		[BC_INST_PUSH_TO_VAR] = BC_PROG_LBL(BC_INST_PUSH_TO_VAR),
+		[BC_INST_QUIT] = BC_PROG_LBL(BC_INST_QUIT),
+		[BC_INST_NQUIT] = BC_PROG_LBL(BC_INST_NQUIT),
+#endif // DC_ENABLED
+#if BC_ENABLED
+		[BC_INST_JUMP_REL] = BC_PROG_LBL(BC_INST_JUMP_REL),
+		[BC_INST_VAR_OP] = BC_PROG_LBL(BC_INST_VAR_OP),
+		[BC_INST_VAR_OP_ASSIGN] = BC_PROG_LBL(BC_INST_VAR_OP_ASSIGN),
+		[BC_INST_OP_ASSIGN] = BC_PROG_LBL(BC_INST_OP_ASSIGN),
+		[BC_INST_ASSIGN_VAR] = BC_PROG_LBL(BC_INST_ASSIGN_VAR),
+		[BC_INST_EXPR] = BC_PROG_LBL(BC_INST_EXPR),
+		[BC_INST_EXPR_ASSIGN] = BC_PROG_LBL(BC_INST_EXPR_ASSIGN),
+		[BC_INST_EXPR_JUMP] = BC_PROG_LBL(BC_INST_EXPR_JUMP),
+#endif // BC_ENABLED
+	};
+#endif // BC_PROG_THREADED
+
 	bc_program_setVecs(p, func);
 
-	while (ip->idx < func->code.len) {
+	while (ip->idx < func->insts.len) {
 
 		BC_SIG_ASSERT_NOT_LOCKED;
 
-		uchar inst = (uchar) code[(ip->idx)++];
+		inst = (uchar) code[(ip->idx)++];
 
-		switch (inst) {
+		BC_PROG_SWITCH(inst) {
 
 #if BC_ENABLED
-			case BC_INST_JUMP_ZERO:
+			BC_PROG_CASE(BC_INST_JUMP_ZERO)
 			{
 				bc_program_prep(p, &ptr, &num, 0);
 				cond = !bc_num_cmpZero(num);
 				bc_vec_pop(&p->results);
+
+				idx = code[(ip->idx)++];
+
+				if (cond) {
+					assert(idx != SIZE_MAX);
+					ip->idx = idx;
+				}
+
+				BC_PROG_NEXT;
 			}
-			// Fallthrough.
-			BC_FALLTHROUGH
 
-			case BC_INST_JUMP:
+			BC_PROG_CASE(BC_INST_JUMP)
 			{
-				idx = bc_program_index(code, &ip->idx);
+				idx = code[ip->idx];
 
-				if (inst == BC_INST_JUMP || cond) {
+				assert(idx != SIZE_MAX);
 
-					size_t *addr = bc_vec_item(&func->labels, idx);
+				ip->idx = idx;
 
-					assert(*addr != SIZE_MAX);
+				BC_PROG_NEXT;
+			}
+
+			BC_PROG_CASE(BC_INST_JUMP_REL)
+			{
+				inst = (uchar) code[(ip->idx)++];
+				cond = bc_program_cond(p, inst, 0);
+				bc_vec_npop(&p->results, 2);
 
-					ip->idx = *addr;
+				idx = code[(ip->idx)++];
+
+				if (!cond) {
+					assert(idx != SIZE_MAX);
+					ip->idx = idx;
 				}
 
-				break;
+				BC_PROG_NEXT;
 			}
 
-			case BC_INST_CALL:
+			BC_PROG_CASE(BC_INST_VAR_OP)
+			BC_PROG_CASE(BC_INST_VAR_OP_ASSIGN)
+			{
+				cond = (inst == BC_INST_VAR_OP_ASSIGN);
+				bc_program_varOp(p, code, &ip->idx);
+				if (cond) bc_program_assignTemp(p);
+				BC_PROG_NEXT;
+			}
+
+			BC_PROG_CASE(BC_INST_OP_ASSIGN)
+			{
+				bc_program_op(p, (uchar) code[(ip->idx)++]);
+				bc_program_assignTemp(p);
+				BC_PROG_NEXT;
+			}
+
+			BC_PROG_CASE(BC_INST_ASSIGN_VAR)
+			{
+				bc_program_assignVar(p, code, &ip->idx);
+				BC_PROG_NEXT;
+			}
+
+			BC_PROG_CASE(BC_INST_EXPR)
+			{
+				bc_program_expr(p, func, code, &ip->idx);
+				BC_PROG_NEXT;
+			}
+
+			BC_PROG_CASE(BC_INST_EXPR_ASSIGN)
+			{
+				bc_program_exprAssign(p, func, code, &ip->idx);
+				BC_PROG_NEXT;
+			}
+
+			BC_PROG_CASE(BC_INST_EXPR_JUMP)
+			{
+				num = bc_program_regs(p, func, code, &ip->idx);
+				idx = code[(ip->idx)++];
+
+				if (!bc_num_cmpZero(num)) {
+					assert(idx != SIZE_MAX);
+					ip->idx = idx;
+				}
+
+				BC_PROG_NEXT;
+			}
+
+			BC_PROG_CASE(BC_INST_CALL)
+			BC_PROG_CASE(BC_INST_TAIL_CALL)
 			{
 				assert(BC_IS_BC);
 
-				bc_program_call(p, code, &ip->idx);
+				bc_program_call(p, code, &ip->idx,
+				                inst == BC_INST_TAIL_CALL);
 
 				ip = bc_vec_top(&p->stack);
 				func = bc_vec_item(&p->fns, ip->func);
-				code = func->code.v;
+				code = bc_program_decode(func);
 
 				bc_program_setVecs(p, func);
 
-				break;
+				BC_PROG_NEXT;
 			}
 
-			case BC_INST_INC:
-			case BC_INST_DEC:
+			BC_PROG_CASE(BC_INST_INC)
+			BC_PROG_CASE(BC_INST_DEC)
 			{
 				bc_program_incdec(p, inst);
-				break;
+				BC_PROG_NEXT;
 			}
 
-			case BC_INST_HALT:
+			BC_PROG_CASE(BC_INST_HALT)
 			{
 				vm.status = BC_STATUS_QUIT;
 				BC_VM_JMP;
-				break;
+				BC_PROG_NEXT;
 			}
 
-			case BC_INST_RET:
-			case BC_INST_RET0:
-			case BC_INST_RET_VOID:
+			BC_PROG_CASE(BC_INST_RET)
+			BC_PROG_CASE(BC_INST_RET0)
+			BC_PROG_CASE(BC_INST_RET_VOID)
 			{
 				bc_program_return(p, inst);
 
 				ip = bc_vec_top(&p->stack);
 				func = bc_vec_item(&p->fns, ip->func);
-				code = func->code.v;
+				code = bc_program_decode(func);
 
 				bc_program_setVecs(p, func);
 
-				break;
+				BC_PROG_NEXT;
 			}
 #endif // BC_ENABLED
 
-			case BC_INST_BOOL_OR:
-			case BC_INST_BOOL_AND:
-			case BC_INST_REL_EQ:
-			case BC_INST_REL_LE:
-			case BC_INST_REL_GE:
-			case BC_INST_REL_NE:
-			case BC_INST_REL_LT:
-			case BC_INST_REL_GT:
+			BC_PROG_CASE(BC_INST_BOOL_OR)
+			BC_PROG_CASE(BC_INST_BOOL_AND)
+			BC_PROG_CASE(BC_INST_REL_EQ)
+			BC_PROG_CASE(BC_INST_REL_LE)
+			BC_PROG_CASE(BC_INST_REL_GE)
+			BC_PROG_CASE(BC_INST_REL_NE)
+			BC_PROG_CASE(BC_INST_REL_LT)
+			BC_PROG_CASE(BC_INST_REL_GT)
 			{
 				bc_program_logical(p, inst);
-				break;
+				BC_PROG_NEXT;
 			}
 
-			case BC_INST_READ:
+			BC_PROG_CASE(BC_INST_READ)
 			{
 				// We want to flush output before
 				// this in case there is a prompt.
@@ -1942,168 +2804,168 @@ void bc_program_exec(BcProgram *p) {
 
 				ip = bc_vec_top(&p->stack);
 				func = bc_vec_item(&p->fns, ip->func);
-				code = func->code.v;
+				code = bc_program_decode(func);
 
 				bc_program_setVecs(p, func);
 
-				break;
+				BC_PROG_NEXT;
 			}
 
 #if BC_ENABLE_EXTRA_MATH && BC_ENABLE_RAND
-			case BC_INST_RAND:
+			BC_PROG_CASE(BC_INST_RAND)
 			{
 				bc_program_rand(p);
-				break;
+				BC_PROG_NEXT;
 			}
 #endif // BC_ENABLE_EXTRA_MATH && BC_ENABLE_RAND
 
-			case BC_INST_MAXIBASE:
-			case BC_INST_MAXOBASE:
-			case BC_INST_MAXSCALE:
+			BC_PROG_CASE(BC_INST_MAXIBASE)
+			BC_PROG_CASE(BC_INST_MAXOBASE)
+			BC_PROG_CASE(BC_INST_MAXSCALE)
 #if BC_ENABLE_EXTRA_MATH && BC_ENABLE_RAND
-			case BC_INST_MAXRAND:
+			BC_PROG_CASE(BC_INST_MAXRAND)
 #endif // BC_ENABLE_EXTRA_MATH && BC_ENABLE_RAND
 			{
 				BcBigDig dig = vm.maxes[inst - BC_INST_MAXIBASE];
 				bc_program_pushBigdig(p, dig, BC_RESULT_TEMP);
-				break;
+				BC_PROG_NEXT;
 			}
 
-			case BC_INST_VAR:
+			BC_PROG_CASE(BC_INST_VAR)
 			{
 				bc_program_pushVar(p, code, &ip->idx, false, false);
-				break;
+				BC_PROG_NEXT;
 			}
 
-			case BC_INST_ARRAY_ELEM:
+			BC_PROG_CASE(BC_INST_ARRAY_ELEM)
 #if BC_ENABLED
-			case BC_INST_ARRAY:
+			BC_PROG_CASE(BC_INST_ARRAY)
 #endif // BC_ENABLED
 			{
 				bc_program_pushArray(p, code, &ip->idx, inst);
-				break;
+				BC_PROG_NEXT;
 			}
 
-			case BC_INST_IBASE:
-			case BC_INST_SCALE:
-			case BC_INST_OBASE:
+			BC_PROG_CASE(BC_INST_IBASE)
+			BC_PROG_CASE(BC_INST_SCALE)
+			BC_PROG_CASE(BC_INST_OBASE)
 			{
 				bc_program_pushGlobal(p, inst);
-				break;
+				BC_PROG_NEXT;
 			}
 
 #if BC_ENABLE_EXTRA_MATH && BC_ENABLE_RAND
-			case BC_INST_SEED:
+			BC_PROG_CASE(BC_INST_SEED)
 			{
 				bc_program_pushSeed(p);
-				break;
+				BC_PROG_NEXT;
 			}
 #endif // BC_ENABLE_EXTRA_MATH && BC_ENABLE_RAND
 
-			case BC_INST_LENGTH:
-			case BC_INST_SCALE_FUNC:
-			case BC_INST_SQRT:
-			case BC_INST_ABS:
+			BC_PROG_CASE(BC_INST_LENGTH)
+			BC_PROG_CASE(BC_INST_SCALE_FUNC)
+			BC_PROG_CASE(BC_INST_SQRT)
+			BC_PROG_CASE(BC_INST_ABS)
 #if BC_ENABLE_EXTRA_MATH && BC_ENABLE_RAND
-			case BC_INST_IRAND:
+			BC_PROG_CASE(BC_INST_IRAND)
 #endif // BC_ENABLE_EXTRA_MATH && BC_ENABLE_RAND
 			{
 				bc_program_builtin(p, inst);
-				break;
+				BC_PROG_NEXT;
 			}
 
-			case BC_INST_NUM:
+			BC_PROG_CASE(BC_INST_NUM)
 			{
 				bc_program_const(p, code, &ip->idx);
-				break;
+				BC_PROG_NEXT;
 			}
 
-			case BC_INST_ZERO:
-			case BC_INST_ONE:
+			BC_PROG_CASE(BC_INST_ZERO)
+			BC_PROG_CASE(BC_INST_ONE)
 #if BC_ENABLED
-			case BC_INST_LAST:
+			BC_PROG_CASE(BC_INST_LAST)
 #endif // BC_ENABLED
 			{
 				r.t = BC_RESULT_ZERO + (inst - BC_INST_ZERO);
 				bc_vec_push(&p->results, &r);
-				break;
+				BC_PROG_NEXT;
 			}
 
-			case BC_INST_PRINT:
-			case BC_INST_PRINT_POP:
-			case BC_INST_PRINT_STR:
+			BC_PROG_CASE(BC_INST_PRINT)
+			BC_PROG_CASE(BC_INST_PRINT_POP)
+			BC_PROG_CASE(BC_INST_PRINT_STR)
 			{
 				bc_program_print(p, inst, 0);
 				bc_file_flush(&vm.fout, bc_flush_save);
-				break;
+				BC_PROG_NEXT;
 			}
 
-			case BC_INST_STR:
+			BC_PROG_CASE(BC_INST_STR)
 			{
 				r.t = BC_RESULT_STR;
-				r.d.loc.loc = bc_program_index(code, &ip->idx);
+				r.d.loc.loc = code[(ip->idx)++];
 				bc_vec_push(&p->results, &r);
-				break;
+				BC_PROG_NEXT;
 			}
 
-			case BC_INST_POWER:
-			case BC_INST_MULTIPLY:
-			case BC_INST_DIVIDE:
-			case BC_INST_MODULUS:
-			case BC_INST_PLUS:
-			case BC_INST_MINUS:
+			BC_PROG_CASE(BC_INST_POWER)
+			BC_PROG_CASE(BC_INST_MULTIPLY)
+			BC_PROG_CASE(BC_INST_DIVIDE)
+			BC_PROG_CASE(BC_INST_MODULUS)
+			BC_PROG_CASE(BC_INST_PLUS)
+			BC_PROG_CASE(BC_INST_MINUS)
 #if BC_ENABLE_EXTRA_MATH
-			case BC_INST_PLACES:
-			case BC_INST_LSHIFT:
-			case BC_INST_RSHIFT:
+			BC_PROG_CASE(BC_INST_PLACES)
+			BC_PROG_CASE(BC_INST_LSHIFT)
+			BC_PROG_CASE(BC_INST_RSHIFT)
 #endif // BC_ENABLE_EXTRA_MATH
 			{
 				bc_program_op(p, inst);
-				break;
+				BC_PROG_NEXT;
 			}
 
-			case BC_INST_NEG:
-			case BC_INST_BOOL_NOT:
+			BC_PROG_CASE(BC_INST_NEG)
+			BC_PROG_CASE(BC_INST_BOOL_NOT)
 #if BC_ENABLE_EXTRA_MATH
-			case BC_INST_TRUNC:
+			BC_PROG_CASE(BC_INST_TRUNC)
 #endif // BC_ENABLE_EXTRA_MATH
 			{
 				bc_program_unary(p, inst);
-				break;
+				BC_PROG_NEXT;
 			}
 
 #if BC_ENABLED
-			case BC_INST_ASSIGN_POWER:
-			case BC_INST_ASSIGN_MULTIPLY:
-			case BC_INST_ASSIGN_DIVIDE:
-			case BC_INST_ASSIGN_MODULUS:
-			case BC_INST_ASSIGN_PLUS:
-			case BC_INST_ASSIGN_MINUS:
+			BC_PROG_CASE(BC_INST_ASSIGN_POWER)
+			BC_PROG_CASE(BC_INST_ASSIGN_MULTIPLY)
+			BC_PROG_CASE(BC_INST_ASSIGN_DIVIDE)
+			BC_PROG_CASE(BC_INST_ASSIGN_MODULUS)
+			BC_PROG_CASE(BC_INST_ASSIGN_PLUS)
+			BC_PROG_CASE(BC_INST_ASSIGN_MINUS)
 #if BC_ENABLE_EXTRA_MATH
-			case BC_INST_ASSIGN_PLACES:
-			case BC_INST_ASSIGN_LSHIFT:
-			case BC_INST_ASSIGN_RSHIFT:
+			BC_PROG_CASE(BC_INST_ASSIGN_PLACES)
+			BC_PROG_CASE(BC_INST_ASSIGN_LSHIFT)
+			BC_PROG_CASE(BC_INST_ASSIGN_RSHIFT)
 #endif // BC_ENABLE_EXTRA_MATH
-			case BC_INST_ASSIGN:
-			case BC_INST_ASSIGN_POWER_NO_VAL:
-			case BC_INST_ASSIGN_MULTIPLY_NO_VAL:
-			case BC_INST_ASSIGN_DIVIDE_NO_VAL:
-			case BC_INST_ASSIGN_MODULUS_NO_VAL:
-			case BC_INST_ASSIGN_PLUS_NO_VAL:
-			case BC_INST_ASSIGN_MINUS_NO_VAL:
+			BC_PROG_CASE(BC_INST_ASSIGN)
+			BC_PROG_CASE(BC_INST_ASSIGN_POWER_NO_VAL)
+			BC_PROG_CASE(BC_INST_ASSIGN_MULTIPLY_NO_VAL)
+			BC_PROG_CASE(BC_INST_ASSIGN_DIVIDE_NO_VAL)
+			BC_PROG_CASE(BC_INST_ASSIGN_MODULUS_NO_VAL)
+			BC_PROG_CASE(BC_INST_ASSIGN_PLUS_NO_VAL)
+			BC_PROG_CASE(BC_INST_ASSIGN_MINUS_NO_VAL)
 #if BC_ENABLE_EXTRA_MATH
-			case BC_INST_ASSIGN_PLACES_NO_VAL:
-			case BC_INST_ASSIGN_LSHIFT_NO_VAL:
-			case BC_INST_ASSIGN_RSHIFT_NO_VAL:
+			BC_PROG_CASE(BC_INST_ASSIGN_PLACES_NO_VAL)
+			BC_PROG_CASE(BC_INST_ASSIGN_LSHIFT_NO_VAL)
+			BC_PROG_CASE(BC_INST_ASSIGN_RSHIFT_NO_VAL)
 #endif // BC_ENABLE_EXTRA_MATH
 #endif // BC_ENABLED
-			case BC_INST_ASSIGN_NO_VAL:
+			BC_PROG_CASE(BC_INST_ASSIGN_NO_VAL)
 			{
 				bc_program_assign(p, inst);
-				break;
+				BC_PROG_NEXT;
 			}
 
-			case BC_INST_POP:
+			BC_PROG_CASE(BC_INST_POP)
 			{
 #ifndef BC_PROG_NO_STACK_CHECK
 				if (!BC_IS_BC) {
@@ -2115,65 +2977,65 @@ void bc_program_exec(BcProgram *p) {
 				assert(BC_PROG_STACK(&p->results, 1));
 
 				bc_vec_pop(&p->results);
-				break;
+				BC_PROG_NEXT;
 			}
 
 #if DC_ENABLED
-			case BC_INST_POP_EXEC:
+			BC_PROG_CASE(BC_INST_POP_EXEC)
 			{
 				assert(BC_PROG_STACK(&p->stack, 2));
 				bc_vec_pop(&p->stack);
 				bc_vec_pop(&p->tail_calls);
 				ip = bc_vec_top(&p->stack);
 				func = bc_vec_item(&p->fns, ip->func);
-				code = func->code.v;
+				code = bc_program_decode(func);
 				bc_program_setVecs(p, func);
-				break;
+				BC_PROG_NEXT;
 			}
 
-			case BC_INST_MODEXP:
+			BC_PROG_CASE(BC_INST_MODEXP)
 			{
 				bc_program_modexp(p);
-				break;
+				BC_PROG_NEXT;
 			}
 
-			case BC_INST_DIVMOD:
+			BC_PROG_CASE(BC_INST_DIVMOD)
 			{
 				bc_program_divmod(p);
-				break;
+				BC_PROG_NEXT;
 			}
 
-			case BC_INST_EXECUTE:
-			case BC_INST_EXEC_COND:
+			BC_PROG_CASE(BC_INST_EXECUTE)
+			BC_PROG_CASE(BC_INST_EXEC_COND)
 			{
 				cond = (inst == BC_INST_EXEC_COND);
-				bc_program_execStr(p, code, &ip->idx, cond, func->code.len);
+				bc_program_execStr(p, code, &ip->idx, cond, func->insts.len);
 				ip = bc_vec_top(&p->stack);
 				func = bc_vec_item(&p->fns, ip->func);
-				code = func->code.v;
+				code = bc_program_decode(func);
 				bc_program_setVecs(p, func);
-				break;
+				BC_PROG_NEXT;
 			}
 
-			case BC_INST_PRINT_STACK:
+			BC_PROG_CASE(BC_INST_PRINT_STACK)
 			{
 				bc_program_printStack(p);
-				break;
+				BC_PROG_NEXT;
 			}
 
-			case BC_INST_CLEAR_STACK:
+			BC_PROG_CASE(BC_INST_CLEAR_STACK)
 			{
 				bc_vec_popAll(&p->results);
-				break;
+				BC_PROG_NEXT;
 			}
 
-			case BC_INST_STACK_LEN:
+			BC_PROG_CASE(BC_INST_STACK_LEN)
 			{
 				bc_program_stackLen(p);
-				break;
+				BC_PROG_NEXT;
 			}
 
-			case BC_INST_DUPLICATE:
+			BC_PROG_CASE(BC_INST_DUPLICATE)
 			{
 				if (BC_ERR(!BC_PROG_STACK(&p->results, 1)))
 					bc_vm_err(BC_ERR_EXEC_STACK);
@@ -2189,10 +3051,10 @@ void bc_program_exec(BcProgram *p) {
 
 				BC_SIG_UNLOCK;
 
-				break;
+				BC_PROG_NEXT;
 			}
 
-			case BC_INST_SWAP:
+			BC_PROG_CASE(BC_INST_SWAP)
 			{
 				BcResult *ptr2;
 
@@ -2207,57 +3069,57 @@ void bc_program_exec(BcProgram *p) {
 				memcpy(ptr, ptr2, sizeof(BcResult));
 				memcpy(ptr2, &r, sizeof(BcResult));
 
-				break;
+				BC_PROG_NEXT;
 			}
 
-			case BC_INST_ASCIIFY:
+			BC_PROG_CASE(BC_INST_ASCIIFY)
 			{
 				bc_program_asciify(p);
 				ip = bc_vec_top(&p->stack);
 				func = bc_vec_item(&p->fns, ip->func);
-				code = func->code.v;
+				code = bc_program_decode(func);
 				bc_program_setVecs(p, func);
-				break;
+				BC_PROG_NEXT;
 			}
 
-			case BC_INST_PRINT_STREAM:
+			BC_PROG_CASE(BC_INST_PRINT_STREAM)
 			{
 				bc_program_printStream(p);
-				break;
+				BC_PROG_NEXT;
 			}
 
-			case BC_INST_LOAD:
-			case BC_INST_PUSH_VAR:
+			BC_PROG_CASE(BC_INST_LOAD)
+			BC_PROG_CASE(BC_INST_PUSH_VAR)
 			{
 				bool copy = (inst == BC_INST_LOAD);
 				bc_program_pushVar(p, code, &ip->idx, true, copy);
-				break;
+				BC_PROG_NEXT;
 			}
 
-			case BC_INST_PUSH_TO_VAR:
+			BC_PROG_CASE(BC_INST_PUSH_TO_VAR)
 			{
-				idx = bc_program_index(code, &ip->idx);
+				idx = code[(ip->idx)++];
 				bc_program_copyToVar(p, idx, BC_TYPE_VAR, true);
-				break;
+				BC_PROG_NEXT;
 			}
 
-			case BC_INST_QUIT:
-			case BC_INST_NQUIT:
+			BC_PROG_CASE(BC_INST_QUIT)
+			BC_PROG_CASE(BC_INST_NQUIT)
 			{
 				bc_program_nquit(p, inst);
 				ip = bc_vec_top(&p->stack);
 				func = bc_vec_item(&p->fns, ip->func);
-				code = func->code.v;
+				code = bc_program_decode(func);
 				bc_program_setVecs(p, func);
-				break;
+				BC_PROG_NEXT;
 			}
 #endif // DC_ENABLED
-#ifndef NDEBUG
+#if !BC_PROG_THREADED && !defined(NDEBUG)
 			default:
 			{
 				abort();
 			}
-#endif // NDEBUG
+#endif // !BC_PROG_THREADED && !defined(NDEBUG)
 		}
 
 #ifndef NDEBUG
@@ -2320,11 +3182,12 @@ void bc_program_printInst(const BcProgram *p, const char *restrict code,
 		BcConst *c = bc_vec_item(p->consts, idx);
 		bc_vm_printf("(%s)", c->val);
 	}
-	else if (inst == BC_INST_CALL ||
+	else if (inst == BC_INST_CALL || inst == BC_INST_TAIL_CALL ||
 	         (inst > BC_INST_STR && inst <= BC_INST_JUMP_ZERO))
 	{
 		bc_program_printIndex(code, bgn);
-		if (inst == BC_INST_CALL) bc_program_printIndex(code, bgn);
+		if (inst == BC_INST_CALL || inst == BC_INST_TAIL_CALL)
+			bc_program_printIndex(code, bgn);
 	}
 
 	bc_vm_putchar('\n', bc_flush_err);
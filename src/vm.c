@@ -377,6 +377,12 @@ void bc_vm_shutdown(void) {
 
 	BC_SIG_ASSERT_LOCKED;
 
+#if BC_DEBUG_CODE && !BC_ENABLE_LIBRARY
+	bc_file_printf(&vm.ferr, "Digit pool: %zu hits, %zu misses\n",
+	               vm.pool_hits, vm.pool_misses);
+	bc_file_flush(&vm.ferr, bc_flush_none);
+#endif // BC_DEBUG_CODE && !BC_ENABLE_LIBRARY
+
 #if BC_ENABLE_NLS
 	if (vm.catalog != BC_VM_INVALID_CATALOG) catclose(vm.catalog);
 #endif // BC_ENABLE_NLS
@@ -397,8 +403,10 @@ void bc_vm_shutdown(void) {
 	bc_parse_free(&vm.prs);
 #endif // !BC_ENABLE_LIBRARY
 
+	// This has to come first because freeing nums can put them in the pool.
+	bc_vec_free(&vm.last_pows);
+
 	bc_vm_freeTemps();
-	bc_vec_free(&vm.temps);
 #endif // NDEBUG
 
 #if !BC_ENABLE_LIBRARY
@@ -411,10 +419,17 @@ void bc_vm_shutdown(void) {
 void bc_vm_freeTemps(void) {
 
 	size_t i;
+	void *ptr;
 
-	for (i = 0; i < vm.temps.len; ++i) {
-		free(((BcNum*) bc_vec_item(&vm.temps, i))->num);
+	for (i = 0; i < BC_NUM_POOL_CLASSES; ++i) {
+
+		while ((ptr = vm.pool[i]) != NULL) {
+			memcpy(&vm.pool[i], ptr, sizeof(void*));
+			free(ptr);
+		}
 	}
+
+	vm.pool_size = 0;
 }
 #endif // !defined(NDEBUG) || BC_ENABLE_LIBRARY
 
@@ -547,7 +562,9 @@ static void bc_vm_clean(void) {
 
 	// If this condition is true, we can get rid of strings,
 	// constants, and code. This is an idea from busybox.
-	if (good && vm.prog.stack.len == 1 && ip->idx == f->code.len) {
+	if (good && vm.prog.stack.len == 1 && f->decoded == f->code.len &&
+	    ip->idx == f->insts.len)
+	{
 
 #if BC_ENABLED
 		if (BC_IS_BC) {
@@ -562,7 +579,7 @@ static void bc_vm_clean(void) {
 		if (BC_IS_DC) bc_vec_popAll(vm.prog.consts);
 #endif // DC_ENABLED
 
-		bc_vec_popAll(&f->code);
+		bc_func_clearCode(f);
 
 		ip->idx = 0;
 	}
@@ -830,11 +847,17 @@ static void bc_vm_exec(void) {
 #if BC_ENABLED
 	if (BC_IS_BC && (vm.flags & BC_FLAG_L)) {
 
+		bool ibase = vm.prs.ibase;
+
 		bc_vm_load(bc_lib_name, bc_lib);
 
 #if BC_ENABLE_EXTRA_MATH
 		if (!BC_IS_POSIX) bc_vm_load(bc_lib2_name, bc_lib2);
 #endif // BC_ENABLE_EXTRA_MATH
+
+		// The library only touches ibase in functions that put it back, so
+		// constants in main are still known to be in base 10.
+		vm.prs.ibase = ibase;
 	}
 #endif // BC_ENABLED
 
@@ -976,7 +999,11 @@ void bc_vm_init(void) {
 	vm.max.len = bc_num_bigdigMax_size;
 	vm.max2.len = bc_num_bigdigMax2_size;
 
-	bc_vec_init(&vm.temps, sizeof(BcNum), NULL);
+	bc_vec_init(&vm.last_pows, sizeof(BcNum), bc_num_free);
+
+#if BC_NUM_SIMD
+	bc_num_simdInit();
+#endif // BC_NUM_SIMD
 
 	vm.maxes[BC_PROG_GLOBALS_IBASE] = BC_NUM_MAX_POSIX_IBASE;
 	vm.maxes[BC_PROG_GLOBALS_OBASE] = BC_MAX_OBASE;